@@ -0,0 +1,98 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CDS_ALLOCATOR_H
+#define CDS_ALLOCATOR_H
+
+/*!
+ * \file allocator.h
+ * \author Jonathan Debove
+ * \brief Memory allocator interface of the containers.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Memory allocator interface.
+ * The sizes of the blocks are given back on reallocation and release,
+ * so that arenas and pools do not need to store them.
+ * An allocator shared by several containers must outlive all of them.
+ */
+struct allocator {
+	/*! allocate returns a block of `size` bytes or `NULL`. */
+	void *(*allocate)(void *context, size_t size);
+	/*! reallocate resizes the block `ptr` of `old_size` bytes to `size`
+	 * bytes like `realloc`, `ptr` may be `NULL` (`old_size` is `0`).
+	 */
+	void *(*reallocate)(void *context, void *ptr,
+			size_t old_size, size_t size);
+	/*! deallocate releases the block `ptr` of `size` bytes.
+	 * It may do nothing if the memory is released in one shot.
+	 */
+	void (*deallocate)(void *context, void *ptr, size_t size);
+	void *context;
+};
+
+/* Stupid macro to help doxygen */
+#define STATIC static
+
+/*! allocator_alloc allocates `size` bytes with `a`, or `malloc` if `NULL`. */
+STATIC inline
+void *allocator_alloc(struct allocator const *a, size_t size)
+{
+	return a ? a->allocate(a->context, size) : malloc(size);
+}
+
+/*! allocator_realloc resizes a block with `a`, or `realloc` if `NULL`. */
+STATIC inline
+void *allocator_realloc(struct allocator const *a, void *ptr,
+		size_t old_size, size_t size)
+{
+	return a ? a->reallocate(a->context, ptr, old_size, size) :
+		realloc(ptr, size);
+}
+
+/*! allocator_free releases a block with `a`, or `free` if `NULL`. */
+STATIC inline
+void allocator_free(struct allocator const *a, void *ptr, size_t size)
+{
+	if (a) {
+		if (ptr) {
+			a->deallocate(a->context, ptr, size);
+		}
+	} else {
+		free(ptr);
+	}
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDS_ALLOCATOR_H */
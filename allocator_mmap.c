@@ -0,0 +1,118 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#define _GNU_SOURCE	/* mremap */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "allocator_mmap.h"
+
+#ifndef MAP_ANONYMOUS
+#	define MAP_ANONYMOUS	MAP_ANON
+#endif
+
+/* am_pages rounds `size` up to a multiple of the page size. */
+static
+size_t am_pages(size_t size)
+{
+	static size_t page;
+	if (!page) {
+		long const n = sysconf(_SC_PAGESIZE);
+		page = n > 0 ? (size_t)n : 4096;
+	}
+	return (size + page - 1) & ~(page - 1);
+}
+
+static
+void *am_map(size_t size)
+{
+	void *const p = mmap(NULL, am_pages(size), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+#ifdef MADV_HUGEPAGE
+	madvise(p, am_pages(size), MADV_HUGEPAGE);	/* only a hint */
+#endif
+	return p;
+}
+
+static
+void *am_allocate(void *context, size_t size)
+{
+	(void)context;
+	return size >= ALLOCATOR_MMAP_MIN ? am_map(size) : malloc(size);
+}
+
+static
+void am_deallocate(void *context, void *ptr, size_t size)
+{
+	(void)context;
+	if (size >= ALLOCATOR_MMAP_MIN) {
+		munmap(ptr, am_pages(size));
+	} else {
+		free(ptr);
+	}
+}
+
+static
+void *am_reallocate(void *context, void *ptr, size_t old_size, size_t size)
+{
+	if (!ptr) {
+		return am_allocate(context, size);
+	} else if (old_size < ALLOCATOR_MMAP_MIN && size < ALLOCATOR_MMAP_MIN) {
+		return realloc(ptr, size);
+	}
+
+	void *p;
+#ifdef MREMAP_MAYMOVE
+	if (old_size >= ALLOCATOR_MMAP_MIN && size >= ALLOCATOR_MMAP_MIN) {
+		/* moves page table entries, not data */
+		p = mremap(ptr, am_pages(old_size), am_pages(size),
+				MREMAP_MAYMOVE);
+		if (p == MAP_FAILED) {
+			return NULL;
+		}
+#ifdef MADV_HUGEPAGE
+		madvise(p, am_pages(size), MADV_HUGEPAGE);
+#endif
+		return p;
+	}
+#endif
+	/* crossing the threshold, or no mremap */
+	p = am_allocate(context, size);
+	if (p) {
+		memcpy(p, ptr, old_size < size ? old_size : size);
+		am_deallocate(context, ptr, old_size);
+	}
+	return p;
+}
+
+struct allocator const allocator_mmap = {
+	am_allocate, am_reallocate, am_deallocate, NULL
+};
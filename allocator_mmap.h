@@ -0,0 +1,57 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef CDS_ALLOCATOR_MMAP_H
+#define CDS_ALLOCATOR_MMAP_H
+
+/*!
+ * \file allocator_mmap.h
+ * \author Jonathan Debove
+ * \brief Allocator mapping large blocks with huge pages.
+ */
+
+#include "allocator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Blocks of at least this size are mapped instead of malloc'ed. */
+#define ALLOCATOR_MMAP_MIN	(1L << 21)
+
+/*! Allocator for very large containers, e.g. multi-gigabyte darrays.
+ * Blocks of at least `ALLOCATOR_MMAP_MIN` bytes are mapped with `mmap`
+ * and transparent huge pages are requested (`MADV_HUGEPAGE`) to reduce
+ * TLB misses. Where `mremap` is available (Linux), growing a mapped
+ * block remaps its pages instead of copying them.
+ * Smaller blocks use `malloc`. It has no context.
+ */
+extern struct allocator const allocator_mmap;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDS_ALLOCATOR_MMAP_H */
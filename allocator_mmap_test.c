@@ -0,0 +1,53 @@
+#include <stdio.h>
+
+#include "allocator_mmap.h"
+#include "darray.h"
+#include "htable.h"
+
+#define N (1L << 20)
+
+unsigned long hash(void const *key, unsigned long seed)
+{
+	(void)seed;	/* unused */
+	return (unsigned long)(*(long const *)key);
+}
+int comp(void const *key, void const *entry)
+{
+	return *(long const *)key != *(long const *)entry;
+}
+struct htable_interface iface = { hash, comp };
+
+int main(void)
+{
+	long *e;
+	long i, n;
+	int err;
+
+	struct darray a;
+	darray_create(&a, sizeof(*e));
+	darray_setalloc(&a, &allocator_mmap);			/* Allocator */
+	for (i = 0; i < N; i++) {
+		e = darray_push(&a, 1);				/* Mapped growth */
+		*e = i;
+	}
+	for (i = 0, n = 0; i < N; i++) {
+		n += *(long *)darray_at(&a, i) == i;
+	}
+	printf("darray: %ld/%ld elements, %ld bytes\n", n, N,
+			a.cap * a.inc);
+	darray_destroy(&a);
+
+	struct htable ht;
+	htable_create(&ht, sizeof(*e), 0, &iface);
+	htable_setalloc(&ht, &allocator_mmap);			/* Allocator */
+	for (i = 0; i < N; i++) {
+		htable_enter(&ht, &i, &i, &err);
+	}
+	for (i = 0, n = 0; i < N; i++) {
+		n += htable_find(&ht, &i) != NULL;
+	}
+	printf("htable: %ld/%ld entries\n", n, N);
+	htable_destroy(&ht);
+
+	return 0;
+}
@@ -23,20 +23,415 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "base64.h"
+#include "darray.h"
+#include "dstring.h"
+
+#ifndef BASE64_USE_SIMD
+/*! Flag to use the SIMD kernels for the bulk of the data. */
+#define BASE64_USE_SIMD	1
+#endif
+
+#if BASE64_USE_SIMD && defined(__GNUC__) \
+		&& (defined(__x86_64__) || defined(__i386__))
+/* selected at runtime, one function per instruction set */
+#	define BASE64_X86	1
+#	include <immintrin.h>
+#elif BASE64_USE_SIMD && defined(__aarch64__)
+/* Advanced SIMD is part of the base AArch64 architecture */
+#	define BASE64_NEON	1
+#	include <arm_neon.h>
+#endif
 
 static char const encoding[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 static char const padding = '=';
-static uint8_t decoding[257] = { 0 };
 static uint8_t const invalid = 0xff;
+static uint8_t const decoding[256] = {
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  62, 255, 255, 255,  63,
+	 52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255, 255,
+	255,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+	 15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, 255, 255, 255, 255, 255,
+	255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+	 41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+};
 
 // C11
 //static_assert(sizeof(encoding) == 64 + 1);
-//static_assert(sizeof(decoding) == 256 + 1);
+//static_assert(sizeof(decoding) == 256);
+
+/*
+ * The kernels encode or decode the bulk of the data and return the number of
+ * bytes consumed from `src`, a multiple of 3 (encode) or 4 (decode), leaving
+ * the rest to the scalar code. They may read and write past the quanta
+ * they consume, but never past `src + n` nor past the encoded or decoded
+ * size of `n` bytes.
+ * The decode kernels never consume the last quantum, which may be padded,
+ * and stop on the first block holding an invalid character: the scalar code
+ * then finds it and returns NULL.
+ */
+
+#if BASE64_X86
+
+/* Spreads 12 bytes to 16 6-bit indices, one per byte (Mula, Lemire). */
+__attribute__((target("ssse3")))
+static inline __m128i encode_ssse3_indices(__m128i in)
+{
+	in = _mm_shuffle_epi8(in, _mm_setr_epi8(
+				1, 0, 2, 1, 4, 3, 5, 4,
+				7, 6, 8, 7, 10, 9, 11, 10));
+	__m128i const t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	__m128i const t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	__m128i const t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	__m128i const t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
+
+/* Maps indices to characters by adding the offset of their range. */
+__attribute__((target("ssse3")))
+static inline __m128i encode_ssse3_chars(__m128i idx)
+{
+	__m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+	__m128i const lt = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+	r = _mm_or_si128(r, _mm_and_si128(lt, _mm_set1_epi8(13)));
+	r = _mm_shuffle_epi8(_mm_setr_epi8(
+				'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+				'0' - 52, '0' - 52, '0' - 52, '0' - 52,
+				'0' - 52, '0' - 52, '0' - 52, '+' - 62,
+				'/' - 63, 'A', 0, 0), r);
+	return _mm_add_epi8(r, idx);
+}
+
+__attribute__((target("ssse3")))
+static size_t encode_ssse3(char *dst, uint8_t const *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 16 <= n; i += 12, dst += 16) {
+		__m128i in = _mm_loadu_si128((__m128i const *)(src + i));
+		in = encode_ssse3_chars(encode_ssse3_indices(in));
+		_mm_storeu_si128((__m128i *)dst, in);
+	}
+	return i;
+}
+
+/* Maps characters to 6-bit values, or returns 0 on invalid characters. */
+__attribute__((target("ssse3")))
+static inline int decode_ssse3_values(__m128i *in)
+{
+	__m128i const lut_lo = _mm_setr_epi8(
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	__m128i const lut_hi = _mm_setr_epi8(
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	__m128i const lut_roll = _mm_setr_epi8(
+			0, 16, 19, 4, -65, -65, -71, -71,
+			0, 0, 0, 0, 0, 0, 0, 0);
+	__m128i const m2f = _mm_set1_epi8(0x2f);
+
+	__m128i const hi_nib = _mm_and_si128(_mm_srli_epi32(*in, 4), m2f);
+	__m128i const lo = _mm_shuffle_epi8(lut_lo, _mm_and_si128(*in, m2f));
+	__m128i const hi = _mm_shuffle_epi8(lut_hi, hi_nib);
+	if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+					_mm_setzero_si128()))) {
+		return 0;
+	}
+	__m128i const eq2f = _mm_cmpeq_epi8(*in, m2f);
+	__m128i const roll = _mm_shuffle_epi8(lut_roll,
+			_mm_add_epi8(eq2f, hi_nib));
+	*in = _mm_add_epi8(*in, roll);
+	return 1;
+}
+
+/* Packs 16 6-bit values to 12 bytes, followed by 4 zero bytes. */
+__attribute__((target("ssse3")))
+static inline __m128i decode_ssse3_pack(__m128i v)
+{
+	v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+	v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+	return _mm_shuffle_epi8(v, _mm_setr_epi8(
+				2, 1, 0, 6, 5, 4, 10, 9,
+				8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+__attribute__((target("ssse3")))
+static size_t decode_ssse3(uint8_t *dst, char const *src, size_t n)
+{
+	size_t i = 0;
+	/* 16 bytes are stored: 8 more characters must follow */
+	for (; i + 16 + 8 <= n; i += 16, dst += 12) {
+		__m128i in = _mm_loadu_si128((__m128i const *)(src + i));
+		if (!decode_ssse3_values(&in)) {
+			break;
+		}
+		_mm_storeu_si128((__m128i *)dst, decode_ssse3_pack(in));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t encode_avx2(char *dst, uint8_t const *src, size_t n)
+{
+	size_t i = 0;
+	for (; i + 12 + 16 <= n; i += 24, dst += 32) {
+		__m128i const lo = _mm_loadu_si128((__m128i const *)(src + i));
+		__m128i const hi = _mm_loadu_si128(
+				(__m128i const *)(src + i + 12));
+		__m256i in = _mm256_inserti128_si256(
+				_mm256_castsi128_si256(lo), hi, 1);
+
+		/* same as SSSE3, on two lanes */
+		in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(
+					1, 0, 2, 1, 4, 3, 5, 4,
+					7, 6, 8, 7, 10, 9, 11, 10,
+					1, 0, 2, 1, 4, 3, 5, 4,
+					7, 6, 8, 7, 10, 9, 11, 10));
+		__m256i const t0 = _mm256_and_si256(in,
+				_mm256_set1_epi32(0x0fc0fc00));
+		__m256i const t1 = _mm256_mulhi_epu16(t0,
+				_mm256_set1_epi32(0x04000040));
+		__m256i const t2 = _mm256_and_si256(in,
+				_mm256_set1_epi32(0x003f03f0));
+		__m256i const t3 = _mm256_mullo_epi16(t2,
+				_mm256_set1_epi32(0x01000010));
+		__m256i const idx = _mm256_or_si256(t1, t3);
+
+		__m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+		__m256i const lt = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx);
+		r = _mm256_or_si256(r, _mm256_and_si256(lt,
+					_mm256_set1_epi8(13)));
+		r = _mm256_shuffle_epi8(_mm256_setr_epi8(
+					'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+					'0' - 52, '0' - 52, '0' - 52, '0' - 52,
+					'0' - 52, '0' - 52, '0' - 52, '+' - 62,
+					'/' - 63, 'A', 0, 0,
+					'a' - 26, '0' - 52, '0' - 52, '0' - 52,
+					'0' - 52, '0' - 52, '0' - 52, '0' - 52,
+					'0' - 52, '0' - 52, '0' - 52, '+' - 62,
+					'/' - 63, 'A', 0, 0), r);
+		_mm256_storeu_si256((__m256i *)dst, _mm256_add_epi8(r, idx));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t decode_avx2(uint8_t *dst, char const *src, size_t n)
+{
+	__m256i const lut_lo = _mm256_setr_epi8(
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+			0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+			0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+	__m256i const lut_hi = _mm256_setr_epi8(
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+			0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+			0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	__m256i const lut_roll = _mm256_setr_epi8(
+			0, 16, 19, 4, -65, -65, -71, -71,
+			0, 0, 0, 0, 0, 0, 0, 0,
+			0, 16, 19, 4, -65, -65, -71, -71,
+			0, 0, 0, 0, 0, 0, 0, 0);
+	__m256i const m2f = _mm256_set1_epi8(0x2f);
+
+	size_t i = 0;
+	/* 32 bytes are stored: 16 more characters must follow */
+	for (; i + 32 + 16 <= n; i += 32, dst += 24) {
+		__m256i in = _mm256_loadu_si256((__m256i const *)(src + i));
+		__m256i const hi_nib = _mm256_and_si256(
+				_mm256_srli_epi32(in, 4), m2f);
+		__m256i const lo = _mm256_shuffle_epi8(lut_lo,
+				_mm256_and_si256(in, m2f));
+		__m256i const hi = _mm256_shuffle_epi8(lut_hi, hi_nib);
+		if (!_mm256_testz_si256(lo, hi)) {
+			break;
+		}
+		__m256i const eq2f = _mm256_cmpeq_epi8(in, m2f);
+		in = _mm256_add_epi8(in, _mm256_shuffle_epi8(lut_roll,
+					_mm256_add_epi8(eq2f, hi_nib)));
+
+		in = _mm256_maddubs_epi16(in, _mm256_set1_epi32(0x01400140));
+		in = _mm256_madd_epi16(in, _mm256_set1_epi32(0x00011000));
+		in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(
+					2, 1, 0, 6, 5, 4, 10, 9,
+					8, 14, 13, 12, -1, -1, -1, -1,
+					2, 1, 0, 6, 5, 4, 10, 9,
+					8, 14, 13, 12, -1, -1, -1, -1));
+		in = _mm256_permutevar8x32_epi32(in,
+				_mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+		_mm256_storeu_si256((__m256i *)dst, in);
+	}
+	return i;
+}
+
+/* Byte permutation of the VBMI decoder, 0 for the 16 unused bytes. */
+static uint8_t const vbmi_pack[64] = {
+	 2,  1,  0,  6,  5,  4, 10,  9,  8, 14, 13, 12, 18, 17, 16, 22,
+	21, 20, 26, 25, 24, 30, 29, 28, 34, 33, 32, 38, 37, 36, 42, 41,
+	40, 46, 45, 44, 50, 49, 48, 54, 53, 52, 58, 57, 56, 62, 61, 60,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+static size_t encode_vbmi(char *dst, uint8_t const *src, size_t n)
+{
+	__m512i const spread = _mm512_setr_epi32(
+			0x01020001, 0x04050304, 0x07080607, 0x0a0b090a,
+			0x0d0e0c0d, 0x10110f10, 0x13141213, 0x16171516,
+			0x191a1819, 0x1c1d1b1c, 0x1f201e1f, 0x22232122,
+			0x25262425, 0x28292728, 0x2b2c2a2b, 0x2e2f2d2e);
+	/* bit offsets of the 4 indices in each spread 32-bit word */
+	__m512i const shifts = _mm512_set1_epi64(0x3036242a1016040a);
+	__m512i const lut = _mm512_loadu_si512((void const *)encoding);
+
+	size_t i = 0;
+	for (; i + 64 <= n; i += 48, dst += 64) {
+		__m512i in = _mm512_loadu_si512((void const *)(src + i));
+		in = _mm512_permutexvar_epi8(spread, in);
+		in = _mm512_multishift_epi64_epi8(shifts, in);
+		in = _mm512_permutexvar_epi8(in, lut);
+		_mm512_storeu_si512((void *)dst, in);
+	}
+	return i;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+static size_t decode_vbmi(uint8_t *dst, char const *src, size_t n)
+{
+	__m512i const lut0 = _mm512_loadu_si512((void const *)decoding);
+	__m512i const lut1 = _mm512_loadu_si512((void const *)(decoding + 64));
+	__m512i const pack = _mm512_loadu_si512((void const *)vbmi_pack);
+
+	size_t i = 0;
+	/* 64 bytes are stored: 24 more characters must follow */
+	for (; i + 64 + 24 <= n; i += 64, dst += 48) {
+		__m512i const in = _mm512_loadu_si512((void const *)(src + i));
+		/* invalid: decoded to 0xff or not ASCII */
+		__m512i v = _mm512_permutex2var_epi8(lut0, in, lut1);
+		if (_mm512_movepi8_mask(_mm512_or_si512(v, in))) {
+			break;
+		}
+		v = _mm512_maddubs_epi16(v, _mm512_set1_epi32(0x01400140));
+		v = _mm512_madd_epi16(v, _mm512_set1_epi32(0x00011000));
+		v = _mm512_permutexvar_epi8(pack, v);
+		_mm512_storeu_si512((void *)dst, v);
+	}
+	return i;
+}
+
+static size_t encode_simd(char *dst, uint8_t const *src, size_t n)
+{
+	if (__builtin_cpu_supports("avx512vbmi")) {
+		return encode_vbmi(dst, src, n);
+	} else if (__builtin_cpu_supports("avx2")) {
+		return encode_avx2(dst, src, n);
+	} else if (__builtin_cpu_supports("ssse3")) {
+		return encode_ssse3(dst, src, n);
+	}
+	return 0;
+}
+
+static size_t decode_simd(uint8_t *dst, char const *src, size_t n)
+{
+	if (__builtin_cpu_supports("avx512vbmi")) {
+		return decode_vbmi(dst, src, n);
+	} else if (__builtin_cpu_supports("avx2")) {
+		return decode_avx2(dst, src, n);
+	} else if (__builtin_cpu_supports("ssse3")) {
+		return decode_ssse3(dst, src, n);
+	}
+	return 0;
+}
+
+#elif BASE64_NEON
+
+static uint8x16x4_t neon_lut(uint8_t const *p)
+{
+	uint8x16x4_t t;
+	t.val[0] = vld1q_u8(p);
+	t.val[1] = vld1q_u8(p + 16);
+	t.val[2] = vld1q_u8(p + 32);
+	t.val[3] = vld1q_u8(p + 48);
+	return t;
+}
+
+static size_t encode_simd(char *dst, uint8_t const *src, size_t n)
+{
+	uint8x16x4_t const lut = neon_lut((uint8_t const *)encoding);
+	uint8x16_t const m3f = vdupq_n_u8(0x3f);
+
+	size_t i = 0;
+	for (; i + 48 <= n; i += 48, dst += 64) {
+		uint8x16x3_t const in = vld3q_u8(src + i);
+		uint8x16x4_t out;
+		out.val[0] = vshrq_n_u8(in.val[0], 2);
+		out.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4),
+					vshrq_n_u8(in.val[1], 4)), m3f);
+		out.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2),
+					vshrq_n_u8(in.val[2], 6)), m3f);
+		out.val[3] = vandq_u8(in.val[2], m3f);
+		out.val[0] = vqtbl4q_u8(lut, out.val[0]);
+		out.val[1] = vqtbl4q_u8(lut, out.val[1]);
+		out.val[2] = vqtbl4q_u8(lut, out.val[2]);
+		out.val[3] = vqtbl4q_u8(lut, out.val[3]);
+		vst4q_u8((uint8_t *)dst, out);
+	}
+	return i;
+}
+
+/* Maps characters to 6-bit values, not ASCII characters to 0. */
+static inline uint8x16_t neon_values(uint8x16x4_t const *lo,
+		uint8x16x4_t const *hi, uint8x16_t in)
+{
+	uint8x16_t const v = vqtbl4q_u8(*lo, in);
+	return vqtbx4q_u8(v, *hi, vsubq_u8(in, vdupq_n_u8(64)));
+}
+
+static size_t decode_simd(uint8_t *dst, char const *src, size_t n)
+{
+	uint8x16x4_t const lo = neon_lut(decoding);
+	uint8x16x4_t const hi = neon_lut(decoding + 64);
+
+	size_t i = 0;
+	/* exactly 48 bytes are stored, keep the last quantum */
+	for (; i + 64 + 4 <= n; i += 64, dst += 48) {
+		uint8x16x4_t const in = vld4q_u8((uint8_t const *)src + i);
+		uint8x16_t const a = neon_values(&lo, &hi, in.val[0]);
+		uint8x16_t const b = neon_values(&lo, &hi, in.val[1]);
+		uint8x16_t const c = neon_values(&lo, &hi, in.val[2]);
+		uint8x16_t const d = neon_values(&lo, &hi, in.val[3]);
+		/* invalid: decoded to 0xff or not ASCII */
+		uint8x16_t err = vorrq_u8(vorrq_u8(a, b), vorrq_u8(c, d));
+		err = vorrq_u8(err, vorrq_u8(vorrq_u8(in.val[0], in.val[1]),
+					vorrq_u8(in.val[2], in.val[3])));
+		if (vmaxvq_u8(err) & 0x80) {
+			break;
+		}
+		uint8x16x3_t out;
+		out.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+		out.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+		out.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+		vst3q_u8(dst, out);
+	}
+	return i;
+}
+
+#endif
 
 char *base64_encode(char *dst, void const *src, size_t n)
 {
@@ -44,6 +439,11 @@ char *base64_encode(char *dst, void const *src, size_t n)
 	assert(src);
 
 	uint8_t const *s = src;
+#if BASE64_X86 || BASE64_NEON
+	size_t const k = encode_simd(dst, s, n);
+	s += k;
+	dst += k / 3 * 4;
+#endif
 	uint8_t const *end = (uint8_t const *)src + (n / 3) * 3;
 	uint32_t val = 0;
 	while (s != end) {
@@ -82,7 +482,7 @@ char *base64_encode(char *dst, void const *src, size_t n)
 }
 
 #define DECODE_CHAR(c, s) do {			\
-	(c) = decoding[(int)(*(s)++)];		\
+	(c) = decoding[(uint8_t)*(s)++];	\
 	if ((c) == invalid) return NULL;	\
 } while (0)
 
@@ -91,18 +491,18 @@ void *base64_decode(void *dst, char const *src, size_t n)
 	assert(dst);
 	assert(src);
 
-	if (decoding[256] != invalid) {
-		memset(decoding, invalid, sizeof(decoding));
-		for (int i = 0; i < (int)sizeof(encoding); i++) {
-			decoding[(int)encoding[i]] = i;
-		}
-	}
-
 	uint8_t *d = dst;
 	if (n < 4) {
 		return NULL;
 	}
 
+#if BASE64_X86 || BASE64_NEON
+	size_t const k = decode_simd(d, src, n);
+	src += k;
+	n -= k;
+	d += k / 4 * 3;
+#endif
+
 	char const *end = src + ((n - 4) / 4) * 4;
 	uint32_t val = 0;
 	uint8_t out;
@@ -143,12 +543,227 @@ void *base64_decode(void *dst, char const *src, size_t n)
 	return d;
 }
 
+/* Decodes quanta up to the first one holding an invalid or padding
+ * character and returns the number of characters consumed.
+ */
+static size_t decode_quanta(uint8_t *dst, char const *src, size_t n)
+{
+	size_t i = 0;
+#if BASE64_X86 || BASE64_NEON
+	i = decode_simd(dst, src, n);
+	dst += i / 4 * 3;
+#endif
+	for (; i + 4 <= n; i += 4) {
+		uint8_t const a = decoding[(uint8_t)src[i + 0]];
+		uint8_t const b = decoding[(uint8_t)src[i + 1]];
+		uint8_t const c = decoding[(uint8_t)src[i + 2]];
+		uint8_t const d = decoding[(uint8_t)src[i + 3]];
+		if ((a | b | c | d) == invalid) {
+			break;
+		}
+		uint32_t const val = (uint32_t)a << 18 | (uint32_t)b << 12
+			| (uint32_t)c << 6 | d;
+		*dst++ = val >> 16;
+		*dst++ = val >> 8;
+		*dst++ = val >> 0;
+	}
+	return i;
+}
+
+/* Writes the `len - 1` bytes of a quantum of `len` values. */
+static uint8_t *decode_partial(uint8_t *d, uint8_t const *q, int len)
+{
+	uint32_t const val = (uint32_t)q[0] << 18 | (uint32_t)q[1] << 12
+		| (uint32_t)(len > 2 ? q[2] : 0) << 6
+		| (len > 3 ? q[3] : 0);
+	*d++ = val >> 16;
+	if (len > 2) {
+		*d++ = val >> 8;
+	}
+	if (len > 3) {
+		*d++ = val >> 0;
+	}
+	return d;
+}
+
+static int is_space(int c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static uint8_t *stream_decode(struct base64_stream *bs, uint8_t *d,
+		char const *s, size_t n)
+{
+	char const *const end = s + n;
+	while (s != end) {
+		if (bs->len == 0 && !bs->pad && end - s >= 4) {
+			size_t const k = decode_quanta(d, s, end - s);
+			s += k;
+			d += k / 4 * 3;
+			if (s == end) {
+				break;
+			}
+		}
+
+		/* one character at a time up to the next quantum */
+		int const c = (uint8_t)*s++;
+		if ((bs->flags & BASE64_SKIPSPACE) && is_space(c)) {
+			continue;
+		}
+		if (c == padding) {
+			if (bs->len < 2 || bs->len + bs->pad >= 4) {
+				return NULL;
+			}
+			if (bs->len + ++bs->pad == 4) {
+				d = decode_partial(d, bs->quantum, bs->len);
+				bs->len = 0;
+			}
+			continue;
+		}
+		uint8_t const v = decoding[c];
+		if (v == invalid || bs->pad) {
+			return NULL;
+		}
+		bs->quantum[bs->len++] = v;
+		if (bs->len == 4) {
+			d = decode_partial(d, bs->quantum, 4);
+			bs->len = 0;
+		}
+	}
+	return d;
+}
+
+static char *stream_encode(struct base64_stream *bs, char *d,
+		uint8_t const *s, size_t n)
+{
+	if (bs->len > 0) {
+		while (bs->len < 3 && n > 0) {
+			bs->quantum[bs->len++] = *s++;
+			n--;
+		}
+		if (bs->len < 3) {
+			return d;
+		}
+		d = base64_encode(d, bs->quantum, 3);
+		bs->len = 0;
+	}
+
+	size_t const k = n / 3 * 3;
+	d = base64_encode(d, s, k);
+	memcpy(bs->quantum, s + k, n - k);
+	bs->len = n - k;
+	return d;
+}
+
+void base64_stream_init(struct base64_stream *bs, int flags)
+{
+	assert(bs);
+
+	bs->flags = flags;
+	bs->len = 0;
+	bs->pad = 0;
+}
+
+size_t base64_stream_size(struct base64_stream const *bs, size_t n)
+{
+	assert(bs);
+
+	if (bs->flags & BASE64_DECODE) {
+		return ((bs->len + n) / 4) * 3 + 2;
+	}
+	return base64_encodedsize(bs->len + n);
+}
+
+void *base64_stream_update(struct base64_stream *bs, void *dst,
+		void const *src, size_t n)
+{
+	assert(bs);
+	assert(dst);
+	assert(src || n == 0);
+
+	if (n == 0) {
+		return dst;
+	} else if (bs->flags & BASE64_DECODE) {
+		return stream_decode(bs, dst, src, n);
+	}
+	return stream_encode(bs, dst, src, n);
+}
+
+void *base64_stream_final(struct base64_stream *bs, void *dst)
+{
+	assert(bs);
+	assert(dst);
+
+	void *end = dst;
+	if (!(bs->flags & BASE64_DECODE)) {
+		end = base64_encode(dst, bs->quantum, bs->len);
+	} else if (bs->len == 1 || (bs->len > 0 && bs->pad)) {
+		end = NULL;
+	} else if (bs->len > 0) {
+		end = decode_partial(dst, bs->quantum, bs->len);
+	}
+	base64_stream_init(bs, bs->flags);
+	return end;
+}
+
+int base64_stream_dstring(struct base64_stream *bs, struct dstring *out,
+		void const *src, size_t n)
+{
+	assert(bs);
+	assert(out);
+
+	long const len = dstring_len(out);
+	size_t const max = base64_stream_size(bs, src ? n : 0);
+	if (max == 0) {
+		return 0;
+	} else if (max > (size_t)(LONG_MAX - 1 - len)) {
+		return -ENOMEM;
+	}
+	int const err = dstring_setlen(out, len + max);
+	if (err) {
+		return err;
+	}
+
+	char *const p = dstring_at(out, len);
+	char *const end = src ?
+		base64_stream_update(bs, p, src, n) :
+		base64_stream_final(bs, p);
+	dstring_setlen(out, end ? len + (end - p) : len);
+	return end ? 0 : -EINVAL;
+}
+
+int base64_stream_darray(struct base64_stream *bs, struct darray *out,
+		void const *src, size_t n)
+{
+	assert(bs);
+	assert(out);
+	assert(out->inc == 1);
+
+	long const len = out->len;
+	size_t const max = base64_stream_size(bs, src ? n : 0);
+	if (max == 0) {
+		return 0;
+	} else if (max > (size_t)(LONG_MAX - len)) {
+		return -ENOMEM;
+	}
+	char *const p = darray_push(out, max);
+	if (!p) {
+		return -ENOMEM;
+	}
+
+	char *const end = src ?
+		base64_stream_update(bs, p, src, n) :
+		base64_stream_final(bs, p);
+	darray_setlen(out, end ? len + (end - p) : len);
+	return end ? 0 : -EINVAL;
+}
+
 #ifdef TEST
 #include <stdio.h>
 int main(void)
 {
 	uint64_t src = 0x0123456789ABCDEF;
-	char dst[base64_decodedsize(sizeof(src)) + 1];
+	char dst[base64_encodedsize(sizeof(src)) + 1];
 	char *p;
 
 	p = base64_encode(dst, &src, sizeof(src));
@@ -27,6 +27,9 @@
 
 #include <stddef.h>
 
+struct darray;
+struct dstring;
+
 /**
  * base64_encode encodes n bytes from the object beginning at src.
  * It writes base64_encodedsize(n) bytes to dst and returns a pointer
@@ -60,4 +63,67 @@ static inline size_t base64_decodedsize(size_t n)
 	return (n / 4) * 3;
 }
 
+/**
+ * Flags of base64_stream_init: the direction, and for decoding whether
+ * spaces, tabs, CR and LF, e.g. the line breaks of MIME bodies, are skipped.
+ */
+enum {
+	BASE64_ENCODE = 0,
+	BASE64_DECODE = 1,
+	BASE64_SKIPSPACE = 2,
+};
+
+/**
+ * Stateful encoder or decoder. It keeps the 0 to 3 bytes of an incomplete
+ * quantum between calls, so data can be fed in arbitrary chunks.
+ */
+struct base64_stream {
+	/* private */
+	int flags;
+	int len;		/* bytes or values in quantum	*/
+	int pad;		/* '=' read, data is over	*/
+	unsigned char quantum[4];
+};
+
+/** base64_stream_init initializes a stream with the flags above. */
+void base64_stream_init(struct base64_stream *bs, int flags);
+
+/**
+ * base64_stream_size returns the maximum number of bytes written by a
+ * base64_stream_update of n bytes followed by base64_stream_final.
+ */
+size_t base64_stream_size(struct base64_stream const *bs, size_t n);
+
+/**
+ * base64_stream_update encodes or decodes n bytes from src.
+ * It writes at most base64_stream_size(bs, n) bytes to dst and returns a
+ * pointer to the byte following the last written byte.
+ * When decoding, it returns NULL on invalid data, including data after
+ * padding. The stream is then left in an unspecified state.
+ */
+void *base64_stream_update(struct base64_stream *bs, void *dst,
+		void const *src, size_t n);
+
+/**
+ * base64_stream_final writes the end of the data: at most 4 padded
+ * characters when encoding, at most 2 bytes when decoding, and returns a
+ * pointer to the byte following the last written byte.
+ * A decoded stream may end without padding, but it returns NULL if a
+ * single character or an incomplete padding remains.
+ * The stream is initialized again for the next data.
+ */
+void *base64_stream_final(struct base64_stream *bs, void *dst);
+
+/**
+ * base64_stream_dstring and base64_stream_darray append the output of
+ * base64_stream_update, or of base64_stream_final if src is NULL, to a
+ * dynamic string or to a dynamic array of bytes (inc == 1).
+ * They return 0 on success, -EINVAL on invalid data or -ENOMEM on out of
+ * memory, in which case out is unchanged.
+ */
+int base64_stream_dstring(struct base64_stream *bs, struct dstring *out,
+		void const *src, size_t n);
+int base64_stream_darray(struct base64_stream *bs, struct darray *out,
+		void const *src, size_t n);
+
 #endif	/* BASE64_H */
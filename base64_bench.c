@@ -0,0 +1,90 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "base64.h"
+#include "bench.h"
+#include "darray.h"
+
+/* Rows: base64,<variant>,<input bytes>,<op>,<throughput>,GB/s */
+
+#define LEN	(1L << 20)
+#define LOOPS	64
+
+int main(void)
+{
+	unsigned char *const src = malloc(LEN);
+	char *const enc = malloc(base64_encodedsize(LEN));
+	unsigned char *const dec = malloc(LEN);
+	uint64_t seed = 1;
+	long i;
+	for (i = 0; i < LEN; i++) {
+		src[i] = (unsigned char)bench_rand(&seed);
+	}
+
+	double best[2] = { 1e300, 1e300 };
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		double t = bench_now();
+		for (i = 0; i < LOOPS; i++) {
+			base64_encode(enc, src, LEN);
+		}
+		t = bench_now() - t;
+		best[0] = t < best[0] ? t : best[0];
+
+		t = bench_now();
+		for (i = 0; i < LOOPS; i++) {
+			if (!base64_decode(dec, enc, base64_encodedsize(LEN))) {
+				fprintf(stderr, "invalid encoding\n");
+			}
+		}
+		t = bench_now() - t;
+		best[1] = t < best[1] ? t : best[1];
+	}
+	/* throughput of the binary side in GB/s, i.e. bytes per ns */
+	bench_row("base64", "random", LEN, "encode", LEN * LOOPS / best[0],
+			"GB/s");
+	bench_row("base64", "random", LEN, "decode", LEN * LOOPS / best[1],
+			"GB/s");
+
+	/* MIME body: 76 character lines, decoded in 4 KiB network reads */
+	long const elen = base64_encodedsize(LEN);
+	char *const mime = malloc(elen + elen / 76 * 2 + 2);
+	long mlen = 0;
+	for (i = 0; i < elen; i += 76) {
+		long const n = elen - i < 76 ? elen - i : 76;
+		memcpy(mime + mlen, enc + i, n);
+		mlen += n;
+		mime[mlen++] = '\r';
+		mime[mlen++] = '\n';
+	}
+	struct darray out;
+	darray_create(&out, 1);
+	double best_mime = 1e300;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		double t = bench_now();
+		for (i = 0; i < LOOPS; i++) {
+			struct base64_stream bs;
+			base64_stream_init(&bs, BASE64_DECODE | BASE64_SKIPSPACE);
+			darray_setlen(&out, 0);
+			long j;
+			for (j = 0; j < mlen; j += 4096) {
+				long const n = mlen - j < 4096 ? mlen - j : 4096;
+				base64_stream_darray(&bs, &out, mime + j, n);
+			}
+			base64_stream_darray(&bs, &out, NULL, 0);
+		}
+		t = bench_now() - t;
+		best_mime = t < best_mime ? t : best_mime;
+	}
+	bench_row("base64", "mime", LEN, "stream-decode",
+			LEN * LOOPS / best_mime, "GB/s");
+	darray_destroy(&out);
+
+	free(mime);
+	free(src);
+	free(enc);
+	free(dec);
+	return 0;
+}
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "base64.h"
+#include "darray.h"
+#include "dstring.h"
+
+int main(void)
+{
+	static char const *const chunks[] = { "Hel", "lo, w", "orld", "!" };
+	static char const mime[] = "SGVsbG8s\r\nIHdvcmxk\r\nIQ==\r\n";
+
+	struct base64_stream bs;
+	struct dstring enc;
+	struct darray dec;
+	int i;
+
+	dstring_create(&enc);
+	base64_stream_init(&bs, BASE64_ENCODE);		/* Encoder */
+	for (i = 0; i < 4; i++) {
+		base64_stream_dstring(&bs, &enc, chunks[i], strlen(chunks[i]));
+	}
+	base64_stream_dstring(&bs, &enc, NULL, 0);		/* Padding */
+	printf("encoded: %s\n", dstring_str(&enc));
+
+	darray_create(&dec, 1);
+	base64_stream_init(&bs, BASE64_DECODE | BASE64_SKIPSPACE);
+	for (i = 0; i < (int)sizeof(mime) - 1; i += 5) {	/* Chunks */
+		int const n = sizeof(mime) - 1 - i < 5 ? sizeof(mime) - 1 - i : 5;
+		if (base64_stream_darray(&bs, &dec, mime + i, n)) {
+			printf("invalid\n");
+		}
+	}
+	base64_stream_darray(&bs, &dec, NULL, 0);
+	printf("decoded: %.*s\n", (int)dec.len, (char *)darray_data(&dec));
+
+	darray_destroy(&dec);
+	dstring_destroy(&enc);
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+/* Helpers of the *_bench.c programs.
+ * Each program prints CSV rows without header:
+ *	bench,variant,size,op,value,unit
+ * `make bench` prints the header then the rows of all the programs.
+ */
+
+#ifndef CDS_BENCH_H
+#define CDS_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Number of runs of a measure, the best one being kept. */
+#define BENCH_RUNS	3
+
+/* bench_now returns a monotonic time in ns. */
+static inline double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* bench_rand is a xorshift64* generator, the same on every platform. */
+static inline uint64_t bench_rand(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545f4914f6cdd1dU;
+}
+
+/* bench_shuffle fills `a` with 0..n-1 in a random order. */
+static inline void bench_shuffle(uint32_t *a, long n, uint64_t seed)
+{
+	long i;
+	for (i = 0; i < n; i++) {
+		a[i] = (uint32_t)i;
+	}
+	for (i = n - 1; i > 0; i--) {
+		long const j = bench_rand(&seed) % (i + 1);
+		uint32_t const tmp = a[i];
+		a[i] = a[j];
+		a[j] = tmp;
+	}
+}
+
+static inline void bench_row(char const *bench, char const *variant, long size,
+		char const *op, double value, char const *unit)
+{
+	printf("%s,%s,%ld,%s,%.3f,%s\n", bench, variant, size, op, value, unit);
+	fflush(stdout);
+}
+
+#endif /* CDS_BENCH_H */
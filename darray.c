@@ -39,13 +39,35 @@ void darray_create(struct darray *da, long inc)
 	da->cap = 0;
 	da->len = 0;
 	da->inc = inc;
+	da->alloc = NULL;
+	da->growth = DARRAY_GROWTH;
+}
+
+void darray_setgrowth(struct darray *da, int percent)
+{
+	assert(da);
+	assert(percent >= 0 && percent <= 100);
+
+	da->growth = percent;
+}
+
+int darray_setalloc(struct darray *da, struct allocator const *alloc)
+{
+	assert(da);
+
+	if (da->len > 0) {
+		return -EBUSY;
+	}
+	darray_destroy(da);
+	da->alloc = alloc;
+	return 0;
 }
 
 void darray_destroy(struct darray *da)
 {
 	assert(da);
 
-	free(da->data);
+	allocator_free(da->alloc, da->data, da->cap * da->inc);
 	da->data = NULL;
 	da->len = 0;
 	da->cap = 0;
@@ -62,7 +84,8 @@ int darray_setcap(struct darray *da, long cap)
 		return 0;
 	}
 
-	char *data = realloc(da->data, cap * da->inc);
+	char *data = allocator_realloc(da->alloc, da->data,
+			da->cap * da->inc, cap * da->inc);
 	if (data) {
 		da->data = data;
 		da->cap = cap;
@@ -75,6 +98,66 @@ int darray_setcap(struct darray *da, long cap)
 	return -ENOMEM;
 }
 
+int darray_shrink_to_fit(struct darray *da)
+{
+	assert(da);
+
+	return da->cap > da->len ? darray_setcap(da, da->len) : 0;
+}
+
+int darray_extend(struct darray *da, void const *src, long n)
+{
+	assert(da);
+	assert(n >= 0);
+	assert(n == 0 || src);
+
+	if (n == 0) {
+		return 0;
+	}
+
+	/* src moves with the array if it is in it */
+	long const inc = da->inc;
+	char const *p = src;
+	long const off = p >= da->data && p < da->data + da->len * inc ?
+		p - da->data : -1;
+
+	char *const dst = darray_push(da, n);
+	if (!dst) {
+		return -ENOMEM;
+	}
+	memcpy(dst, off >= 0 ? da->data + off : p, n * inc);
+	return 0;
+}
+
+void darray_adopt(struct darray *da, void *buf, long len, long cap)
+{
+	assert(da);
+	assert(len >= 0 && len <= cap);
+	assert(!buf == !cap);
+
+	darray_destroy(da);
+	da->data = buf;
+	da->len = len;
+	da->cap = cap;
+}
+
+void *darray_release(struct darray *da, long *len, long *cap)
+{
+	assert(da);
+
+	void *const data = da->data;
+	if (len) {
+		*len = da->len;
+	}
+	if (cap) {
+		*cap = da->cap;
+	}
+	da->data = NULL;
+	da->len = 0;
+	da->cap = 0;
+	return data;
+}
+
 void *darray_splice(struct darray *da, long off, long rem, long ins)
 {
 	assert(da);
@@ -32,8 +32,11 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
 
+#include "allocator.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -46,14 +49,31 @@ struct darray {
 	long len;
 	long cap;
 	long inc;
+	struct allocator const *alloc;	/* NULL for malloc	*/
+	int growth;			/* percent, see darray_setgrowth */
 	//int err;
 };
 
+/*! Default growth of the capacity, in percent. */
+#define DARRAY_GROWTH	50
+
 /*! darray_create initializes a dynamic array `da` of element of size `inc`.
  * It cannot fail and does not allocate memory.
  */
 void darray_create(struct darray *da, long inc);
 
+/*! darray_setalloc sets the allocator of an empty dynamic array, whose
+ * memory is released first. `NULL` restores `malloc`, `realloc` and `free`.
+ * It returns `0` on success or `-EBUSY` if the array is not empty.
+ */
+int darray_setalloc(struct darray *da, struct allocator const *alloc);
+
+/*! darray_setgrowth sets by how much the capacity grows when darray_setlen
+ * exceeds it: `cap * percent / 100 + 8` elements, at least up to the new
+ * length. `percent` is between `0` and `100`, `DARRAY_GROWTH` by default.
+ */
+void darray_setgrowth(struct darray *da, int percent);
+
 /*! darray_destroy frees the memory space internal to the dynamic array.
  * It does not free the memory allocated by the user for the darray nor
  * the entries. On output, the dynamic array is empty and in a valid state.
@@ -98,6 +118,11 @@ void *darray_at(struct darray const *da, long i)
  */
 int darray_setcap(struct darray *da, long cap);
 
+/*! darray_shrink_to_fit sets the capacity of the dynamic array to its length.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int darray_shrink_to_fit(struct darray *da);
+
 /*! darray_setlen sets the number of elements of the dynamic array.
  * It returns `0` on success or `-ENOMEM` on out of memory.
  */
@@ -108,9 +133,12 @@ int darray_setlen(struct darray *da, long len)
 	assert(len >= 0);
 
 	if (len > da->cap) {
+		/* cap * growth / 100 without overflow */
+		long const cap = da->cap;
+		long grow = cap / 100 * da->growth +
+			cap % 100 * da->growth / 100 + 8;
 		/* test overflow */
-		long grow = da->cap / 2 + 8;
-		grow = da->cap <= LONG_MAX - grow ? da->cap + grow : len;
+		grow = cap <= LONG_MAX - grow ? cap + grow : len;
 		int err = darray_setcap(da, grow > len ? grow : len);
 		if (err) {
 			return err;
@@ -159,6 +187,27 @@ void *darray_pop(struct darray *da, long n)
 	return NULL;
 }
 
+/*! darray_extend appends copies of the `n` elements at `src`, which may
+ * be in the array.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int darray_extend(struct darray *da, void const *src, long n);
+
+/*! darray_adopt replaces the memory of the dynamic array, which is freed,
+ * by `buf`: a block of `cap` elements, the first `len` ones in use,
+ * allocated with the allocator of the array (`malloc` by default).
+ * The array owns `buf` on output. `buf` is `NULL` if `cap` is `0`.
+ */
+void darray_adopt(struct darray *da, void *buf, long len, long cap);
+
+/*! darray_release gives the memory of the dynamic array to the caller, who
+ * frees it with `allocator_free(da->alloc, buf, cap * da->inc)`.
+ * It returns the elements, or `NULL` if the capacity is `0`, and stores the
+ * length and the capacity in `len` and `cap` unless they are `NULL`.
+ * On output, the dynamic array is empty and in a valid state.
+ */
+void *darray_release(struct darray *da, long *len, long *cap);
+
 /*! darray_splice removes `rem` elements and inserts `ins` elements at
  * index `off`. The array grows and shrinks as necessary.
  * Returns a pointer to the element at index `off`, or `NULL` if out of memory.
@@ -182,6 +231,84 @@ void *darray_swap(struct darray *da, long i, long j);
 			((elem) = darray_at((darray), da__idx));	\
 			da__idx++)
 
+/*! DARRAY_DEFINE defines `struct name`, a dynamic array of `T`, and its
+ * `static inline` functions `name_create`, `name_destroy`, `name_len`,
+ * `name_at`, `name_setcap`, `name_setlen`, `name_push`, `name_append`
+ * and `name_pop`. They share the growth of `darray_setlen` but index and
+ * copy elements as `T`, so the element size is a constant.
+ * `a->da` may be given to all the other functions of `darray.h`.
+ */
+#define DARRAY_DEFINE(name, T)						\
+struct name {								\
+	struct darray da;						\
+};									\
+									\
+static inline								\
+void name##_create(struct name *a)					\
+{									\
+	darray_create(&a->da, sizeof(T));				\
+}									\
+									\
+static inline								\
+void name##_destroy(struct name *a)					\
+{									\
+	darray_destroy(&a->da);						\
+}									\
+									\
+static inline								\
+long name##_len(struct name const *a)					\
+{									\
+	return a->da.len;						\
+}									\
+									\
+static inline								\
+T *name##_at(struct name const *a, long i)				\
+{									\
+	i = DARRAY_INDEX(&a->da, i);					\
+	return i >= 0 && i < a->da.len ? (T *)a->da.data + i : NULL;	\
+}									\
+									\
+static inline								\
+int name##_setcap(struct name *a, long cap)				\
+{									\
+	return darray_setcap(&a->da, cap);				\
+}									\
+									\
+static inline								\
+int name##_setlen(struct name *a, long len)				\
+{									\
+	return len <= a->da.cap ? (a->da.len = len, 0) :		\
+		darray_setlen(&a->da, len);				\
+}									\
+									\
+static inline								\
+T *name##_push(struct name *a, long n)					\
+{									\
+	long const len = a->da.len;					\
+	return name##_setlen(a, len + n) ? NULL : (T *)a->da.data + len; \
+}									\
+									\
+static inline								\
+int name##_append(struct name *a, T value)				\
+{									\
+	T *const p = name##_push(a, 1);					\
+	if (!p) {							\
+		return -ENOMEM;						\
+	}								\
+	*p = value;							\
+	return 0;							\
+}									\
+									\
+static inline								\
+T *name##_pop(struct name *a, long n)					\
+{									\
+	if (a->da.len < n) {						\
+		return NULL;						\
+	}								\
+	a->da.len -= n;							\
+	return (T *)a->da.data + a->da.len;				\
+}
+
 #ifdef __cplusplus
 }
 #endif
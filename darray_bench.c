@@ -0,0 +1,325 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "darray.h"
+#include "darray_sort.h"
+#include "ddeque.h"
+#include "dheap.h"
+
+/* Rows: darray,<variant>,<len>,<op>,<ns per element or op>,ns */
+
+static void bench_push(long len)
+{
+	static char const *const ops[] = {
+		"push", "push-setcap", "extend-64"
+	};
+	double best[3] = { 1e300, 1e300, 1e300 };
+	long block[64];
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		struct darray a;
+		long i;
+		int k;
+		for (k = 0; k < 3; k++) {
+			darray_create(&a, sizeof(long));
+			double const t = bench_now();
+			if (k == 1) {
+				darray_setcap(&a, len);		/* pre-sized */
+			}
+			if (k == 2) {
+				for (i = 0; i < len; i += 64) {	/* batches */
+					long j;
+					for (j = 0; j < 64; j++) {
+						block[j] = i + j;
+					}
+					darray_extend(&a, block, 64);
+				}
+			} else {
+				for (i = 0; i < len; i++) {
+					*(long *)darray_push(&a, 1) = i;
+				}
+			}
+			double const dt = (bench_now() - t) / len;
+			best[k] = dt < best[k] ? dt : best[k];
+			darray_destroy(&a);
+		}
+	}
+	for (r = 0; r < 3; r++) {
+		bench_row("darray", "long", len, ops[r], best[r], "ns");
+	}
+}
+
+/* insert then remove one element in the middle */
+static void bench_splice(long len)
+{
+	long const n = len < 4096 ? 1L << 16 : (1L << 28) / len;
+	double best = 1e300;
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		struct darray a;
+		darray_create(&a, sizeof(long));
+		darray_push(&a, len);
+		long i;
+		double const t = bench_now();
+		for (i = 0; i < n; i++) {
+			*(long *)darray_splice(&a, len / 2, 0, 1) = i;
+			darray_splice(&a, len / 2, 1, 0);
+		}
+		double const dt = (bench_now() - t) / (2 * n);
+		best = dt < best ? dt : best;
+		darray_destroy(&a);
+	}
+	bench_row("darray", "long", len, "splice", best, "ns");
+}
+
+/* FIFO of len elements: push one at the back, pop one at the front */
+static void bench_queue(long len)
+{
+	long const n = len < 4096 ? 1L << 20 : (1L << 28) / len;
+	double best[2] = { 1e300, 1e300 };
+	long sum = 0;
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		struct darray a;
+		darray_create(&a, sizeof(long));
+		darray_push(&a, len);
+		struct ddeque dq;
+		ddeque_create(&dq, sizeof(long));
+		long i;
+		for (i = 0; i < len; i++) {
+			*(long *)ddeque_push_back(&dq) = i;
+		}
+
+		double t = bench_now();
+		for (i = 0; i < n; i++) {
+			*(long *)darray_push(&a, 1) = i;
+			sum += *(long *)darray_at(&a, 0);
+			darray_splice(&a, 0, 1, 0);
+		}
+		double dt = (bench_now() - t) / n;
+		best[0] = dt < best[0] ? dt : best[0];
+
+		t = bench_now();
+		for (i = 0; i < n; i++) {
+			*(long *)ddeque_push_back(&dq) = i;
+			sum += *(long *)ddeque_pop_front(&dq);
+		}
+		dt = (bench_now() - t) / n;
+		best[1] = dt < best[1] ? dt : best[1];
+
+		darray_destroy(&a);
+		ddeque_destroy(&dq);
+	}
+	if (sum == 42) {
+		fprintf(stderr, "darray_bench: unlikely sum\n");
+	}
+	bench_row("darray", "long", len, "queue-splice", best[0], "ns");
+	bench_row("ddeque", "long", len, "queue", best[1], "ns");
+}
+
+struct rec {
+	uint64_t key;
+	uint64_t val;
+};
+
+static int rec_comp(void const *a, void const *b)
+{
+	struct rec const *x = a, *y = b;
+	return (x->key > y->key) - (x->key < y->key);
+}
+
+static int key_comp(void const *key, void const *elem)
+{
+	uint64_t const k = *(uint64_t const *)key;
+	struct rec const *y = elem;
+	return (k > y->key) - (k < y->key);
+}
+
+/* binary heap with darray_swap, as written by hand */
+static void swapheap_push(struct darray *a, struct rec const *e)
+{
+	long i = a->len;
+	*(struct rec *)darray_push(a, 1) = *e;
+	while (i > 0) {
+		long const p = (i - 1) / 2;
+		if (rec_comp(darray_at(a, i), darray_at(a, p)) >= 0) {
+			break;
+		}
+		darray_swap(a, i, p);
+		i = p;
+	}
+}
+
+static void swapheap_pop(struct darray *a, struct rec *out)
+{
+	*out = *(struct rec *)darray_at(a, 0);
+	darray_swap(a, 0, a->len - 1);
+	darray_pop(a, 1);
+	long i = 0;
+	for (;;) {
+		long m = i, c;
+		for (c = 2 * i + 1; c <= 2 * i + 2 && c < a->len; c++) {
+			if (rec_comp(darray_at(a, c), darray_at(a, m)) < 0) {
+				m = c;
+			}
+		}
+		if (m == i) {
+			break;
+		}
+		darray_swap(a, i, m);
+		i = m;
+	}
+}
+
+/* push len random records, then pop them all */
+static void bench_heap(long len)
+{
+	double best[2] = { 1e300, 1e300 };
+	uint64_t sum = 0;
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		struct darray a;
+		struct dheap h;
+		struct rec e;
+		uint64_t seed;
+		long i;
+
+		darray_create(&a, sizeof(e));
+		seed = r + 1;
+		double t = bench_now();
+		for (i = 0; i < len; i++) {
+			e.key = bench_rand(&seed);
+			e.val = i;
+			swapheap_push(&a, &e);
+		}
+		for (i = 0; i < len; i++) {
+			swapheap_pop(&a, &e);
+			sum += e.key;
+		}
+		double dt = (bench_now() - t) / len;
+		best[0] = dt < best[0] ? dt : best[0];
+		darray_destroy(&a);
+
+		dheap_create(&h, sizeof(e), rec_comp, NULL);
+		seed = r + 1;
+		t = bench_now();
+		for (i = 0; i < len; i++) {
+			e.key = bench_rand(&seed);
+			e.val = i;
+			dheap_push(&h, &e);
+		}
+		for (i = 0; i < len; i++) {
+			dheap_pop(&h, &e);
+			sum -= e.key;
+		}
+		dt = (bench_now() - t) / len;
+		best[1] = dt < best[1] ? dt : best[1];
+		dheap_destroy(&h);
+	}
+	if (sum != 0) {
+		fprintf(stderr, "darray_bench: heaps differ\n");
+	}
+	bench_row("darray", "rec16", len, "swapheap-push-pop", best[0], "ns");
+	bench_row("dheap", "rec16", len, "push-pop", best[1], "ns");
+}
+
+/* 16-byte records with random 64-bit keys */
+static void bench_sort(long len)
+{
+	static char const *const ops[] = {
+		"qsort", "sort-1", "sort", "radixsort"
+	};
+	struct darray a, src;
+	darray_create(&src, sizeof(struct rec));
+	struct rec *const r = darray_push(&src, len);
+	uint64_t seed = 42;
+	long i;
+	for (i = 0; i < len; i++) {
+		r[i].key = bench_rand(&seed);
+		r[i].val = i;
+	}
+	darray_create(&a, sizeof(struct rec));
+	darray_setcap(&a, 2 * len);
+
+	int k;
+	for (k = 0; k < 4; k++) {
+		double best = 1e300;
+		int run;
+		for (run = 0; run < BENCH_RUNS; run++) {
+			darray_setlen(&a, len);
+			memcpy(a.data, r, len * sizeof(*r));
+			double const t = bench_now();
+			switch (k) {
+			case 0:
+				qsort(a.data, len, sizeof(*r), rec_comp);
+				break;
+			case 1:
+				darray_sort(&a, rec_comp, 1);
+				break;
+			case 2:
+				darray_sort(&a, rec_comp, 0);
+				break;
+			default:
+				darray_radixsort(&a, 0, 8, 0);
+			}
+			double const dt = (bench_now() - t) / len;
+			best = dt < best ? dt : best;
+		}
+		bench_row("darray", "rec16", len, ops[k], best, "ns");
+	}
+
+	/* repeated lookups of present keys, libc bsearch for reference */
+	long const n = 1L << 20;
+	double best[2] = { 1e300, 1e300 };
+	long found = 0;
+	int run;
+	for (run = 0; run < BENCH_RUNS; run++) {
+		for (k = 0; k < 2; k++) {
+			seed = run + 1;
+			double const t = bench_now();
+			for (i = 0; i < n; i++) {
+				struct rec const *const e = darray_at(&a,
+						bench_rand(&seed) % len);
+				found += k ? darray_bsearch(&a, &e->key,
+						key_comp) != NULL :
+					bsearch(&e->key, a.data, len,
+						sizeof(*r), key_comp) != NULL;
+			}
+			double const dt = (bench_now() - t) / n;
+			best[k] = dt < best[k] ? dt : best[k];
+		}
+	}
+	if (found != 2 * BENCH_RUNS * n) {
+		fprintf(stderr, "darray_bench: lookup failed\n");
+	}
+	bench_row("darray", "rec16", len, "libc-bsearch", best[0], "ns");
+	bench_row("darray", "rec16", len, "bsearch", best[1], "ns");
+
+	darray_destroy(&a);
+	darray_destroy(&src);
+}
+
+int main(void)
+{
+	static long const lens[] = { 1L << 10, 1L << 16, 1L << 20, 1L << 24 };
+	int i;
+	for (i = 0; i < (int)(sizeof(lens) / sizeof(lens[0])); i++) {
+		bench_push(lens[i]);
+	}
+	for (i = 0; i < 3; i++) {
+		bench_splice(lens[i]);
+	}
+	for (i = 0; i < 3; i++) {
+		bench_queue(lens[i]);
+	}
+	for (i = 0; i < 3; i++) {
+		bench_heap(lens[i]);
+	}
+	for (i = 1; i < 4; i++) {
+		bench_sort(lens[i]);
+	}
+	return 0;
+}
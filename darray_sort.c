@@ -0,0 +1,437 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "darray_sort.h"
+
+#define SORT_RUN	16	/* length of the runs sorted by insertion */
+#define SORT_THREADS	64
+
+typedef int (*sort_comp)(void const *, void const *);
+
+/* Sort or merge task of a thread */
+struct sort_task {
+	sort_comp comp;
+	long inc;
+	char *dst;		/* merge output, or chunk to sort	*/
+	char *tmp;		/* scratch of the chunk			*/
+	char const *a;		/* merge inputs, a == NULL to sort	*/
+	char const *b;
+	long na;
+	long nb;
+};
+
+/* memcpy of a constant size, for the common element sizes */
+static inline
+void sort_copy(char *dst, char const *src, long inc)
+{
+	switch (inc) {
+	case 4:
+		memcpy(dst, src, 4);
+		break;
+	case 8:
+		memcpy(dst, src, 8);
+		break;
+	case 16:
+		memcpy(dst, src, 16);
+		break;
+	default:
+		memcpy(dst, src, inc);
+	}
+}
+
+/* sort_scratch grows the capacity to twice the length, and returns the
+ * start of the spare capacity or NULL on out of memory.
+ */
+static
+char *sort_scratch(struct darray *da)
+{
+	long const len = da->len;
+	if (len > LONG_MAX / 2 / da->inc) {
+		return NULL;
+	}
+	if (da->cap < 2 * len && darray_setcap(da, 2 * len)) {
+		return NULL;
+	}
+	return da->data + len * da->inc;
+}
+
+static
+void sort_insertion(char *a, long n, long inc, sort_comp comp, char *tmp)
+{
+	long i;
+	for (i = 1; i < n; i++) {
+		char *p = a + i * inc;
+		if (comp(p - inc, p) <= 0) {
+			continue;
+		}
+		sort_copy(tmp, p, inc);
+		do {
+			sort_copy(p, p - inc, inc);
+			p -= inc;
+		} while (p > a && comp(p - inc, tmp) > 0);
+		sort_copy(p, tmp, inc);
+	}
+}
+
+/* sort_merge merges a and b into dst; equal elements of a come first */
+static
+void sort_merge(char *dst, char const *a, long na, char const *b, long nb,
+		long inc, sort_comp comp)
+{
+	char const *const ae = a + na * inc;
+	char const *const be = b + nb * inc;
+
+	if (na > 0 && nb > 0 && comp(b, ae - inc) < 0) {
+		while (a < ae && b < be) {
+			if (comp(b, a) < 0) {
+				sort_copy(dst, b, inc);
+				b += inc;
+			} else {
+				sort_copy(dst, a, inc);
+				a += inc;
+			}
+			dst += inc;
+		}
+	}
+	memcpy(dst, a, ae - a);
+	memcpy(dst + (ae - a), b, be - b);
+}
+
+/* sort_chunk sorts n elements at a with n elements of scratch at tmp */
+static
+void sort_chunk(char *a, char *tmp, long n, long inc, sort_comp comp)
+{
+	char *src = a;
+	char *dst = tmp;
+	long i, w;
+
+	for (i = 0; i < n; i += SORT_RUN) {
+		long const m = n - i < SORT_RUN ? n - i : SORT_RUN;
+		sort_insertion(a + i * inc, m, inc, comp, tmp);
+	}
+	for (w = SORT_RUN; w < n; w *= 2) {
+		for (i = 0; i < n; i += 2 * w) {
+			long const na = n - i < w ? n - i : w;
+			long const nb = n - i - na < w ? n - i - na : w;
+			sort_merge(dst + i * inc, src + i * inc, na,
+					src + (i + na) * inc, nb, inc, comp);
+		}
+		char *const t = src;
+		src = dst;
+		dst = t;
+	}
+	if (src != a) {
+		memcpy(a, src, n * inc);
+	}
+}
+
+/* sort_corank returns the number of elements of a among the first k
+ * elements of the merge of a and b.
+ */
+static
+long sort_corank(char const *a, long na, char const *b, long nb, long k,
+		long inc, sort_comp comp)
+{
+	long lo = k > nb ? k - nb : 0;
+	long hi = k < na ? k : na;
+
+	while (lo < hi) {
+		long const i = lo + (hi - lo) / 2;
+		if (comp(b + (k - i - 1) * inc, a + i * inc) < 0) {
+			hi = i;
+		} else {
+			lo = i + 1;
+		}
+	}
+	return lo;
+}
+
+static
+void *sort_worker(void *arg)
+{
+	struct sort_task const *const t = arg;
+
+	if (t->a) {
+		sort_merge(t->dst, t->a, t->na, t->b, t->nb, t->inc, t->comp);
+	} else {
+		sort_chunk(t->dst, t->tmp, t->na, t->inc, t->comp);
+	}
+	return NULL;
+}
+
+/* sort_run runs the tasks on n threads, the calling one included */
+static
+void sort_run(struct sort_task *tasks, int n)
+{
+	pthread_t threads[SORT_THREADS];
+	int started[SORT_THREADS];
+	int i;
+
+	for (i = 1; i < n; i++) {
+		started[i] = !pthread_create(&threads[i], NULL,
+				sort_worker, &tasks[i]);
+		if (!started[i]) {
+			sort_worker(&tasks[i]);
+		}
+	}
+	sort_worker(&tasks[0]);
+	for (i = 1; i < n; i++) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		}
+	}
+}
+
+/* sort_nthreads returns a power of two number of threads to sort len */
+static
+int sort_nthreads(int nthreads, long len)
+{
+	if (nthreads <= 0) {
+		long const n = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = n > 0 && n < SORT_THREADS ? (int)n : SORT_THREADS;
+	} else if (nthreads > SORT_THREADS) {
+		nthreads = SORT_THREADS;
+	}
+	if (len < DARRAY_SORT_PARALLEL) {
+		return 1;
+	}
+
+	int t = 1;
+	while (2 * t <= nthreads) {
+		t *= 2;
+	}
+	return t;
+}
+
+int darray_sort(struct darray *da, sort_comp comp, int nthreads)
+{
+	assert(da);
+	assert(comp);
+
+	long const len = da->len;
+	long const inc = da->inc;
+	if (len < 2) {
+		return 0;
+	}
+
+	char *const tmp = sort_scratch(da);
+	if (!tmp) {
+		return -ENOMEM;
+	}
+	char *const data = da->data;
+
+	struct sort_task tasks[SORT_THREADS];
+	int const nt = sort_nthreads(nthreads, len);
+	long const chunk = (len + nt - 1) / nt;
+	int n = 0;
+	long i;
+
+	for (i = 0; i < len; i += chunk) {
+		struct sort_task *const t = &tasks[n++];
+		t->comp = comp;
+		t->inc = inc;
+		t->dst = data + i * inc;
+		t->tmp = tmp + i * inc;
+		t->a = NULL;
+		t->na = len - i < chunk ? len - i : chunk;
+	}
+	sort_run(tasks, n);
+
+	/* merge pairs of runs, each merge split among nt / pairs threads */
+	char *src = data;
+	char *dst = tmp;
+	long w;
+	for (w = chunk; w < len; w *= 2) {
+		long const pairs = (len + 2 * w - 1) / (2 * w);
+		long const g = nt / pairs > 0 ? nt / pairs : 1;
+		n = 0;
+		for (i = 0; i < len; i += 2 * w) {
+			long const na = len - i < w ? len - i : w;
+			long const nb = len - i - na < w ? len - i - na : w;
+			char const *const a = src + i * inc;
+			char const *const b = a + na * inc;
+			long k0 = 0, i0 = 0, p;
+			for (p = 1; p <= g; p++) {
+				long const k1 = p < g ? p * ((na + nb) / g) :
+					na + nb;
+				long const i1 = sort_corank(a, na, b, nb, k1,
+						inc, comp);
+				struct sort_task *const t = &tasks[n++];
+				t->comp = comp;
+				t->inc = inc;
+				t->dst = dst + (i + k0) * inc;
+				t->a = a + i0 * inc;
+				t->na = i1 - i0;
+				t->b = b + (k0 - i0) * inc;
+				t->nb = (k1 - i1) - (k0 - i0);
+				k0 = k1;
+				i0 = i1;
+			}
+		}
+		sort_run(tasks, n);
+		char *const t = src;
+		src = dst;
+		dst = t;
+	}
+	if (src != data) {
+		memcpy(data, src, len * inc);
+	}
+
+	return 0;
+}
+
+static inline
+uint64_t sort_key(char const *p, int width)
+{
+	uint8_t k8;
+	uint16_t k16;
+	uint32_t k32;
+	uint64_t k64;
+
+	switch (width) {
+	case 1:
+		memcpy(&k8, p, 1);
+		return k8;
+	case 2:
+		memcpy(&k16, p, 2);
+		return k16;
+	case 4:
+		memcpy(&k32, p, 4);
+		return k32;
+	default:
+		memcpy(&k64, p, 8);
+		return k64;
+	}
+}
+
+int darray_radixsort(struct darray *da, long off, int width, int flags)
+{
+	assert(da);
+	assert(width == 1 || width == 2 || width == 4 || width == 8);
+	assert(off >= 0 && off <= da->inc - width);
+
+	long const len = da->len;
+	long const inc = da->inc;
+	if (len < 2) {
+		return 0;
+	}
+
+	char *const tmp = sort_scratch(da);
+	if (!tmp) {
+		return -ENOMEM;
+	}
+	char *const data = da->data;
+
+	/* flipping the sign bit orders signed keys as unsigned ones */
+	uint64_t const flip = flags & DARRAY_SORT_SIGNED ?
+		(uint64_t)0x80 << 8 * (width - 1) : 0;
+	long count[8][256] = { { 0 } };
+	long i;
+	int d;
+
+	for (i = 0; i < len; i++) {
+		uint64_t const k = sort_key(data + i * inc + off, width) ^ flip;
+		for (d = 0; d < width; d++) {
+			count[d][(k >> 8 * d) & 0xff]++;
+		}
+	}
+
+	uint64_t const first = sort_key(data + off, width) ^ flip;
+	char *src = data;
+	char *dst = tmp;
+	for (d = 0; d < width; d++) {
+		long *const c = count[d];
+		if (c[(first >> 8 * d) & 0xff] == len) {
+			continue;	/* all elements have the same digit */
+		}
+
+		long sum = 0;
+		int j;
+		for (j = 0; j < 256; j++) {
+			long const n = c[j];
+			c[j] = sum;
+			sum += n;
+		}
+		for (i = 0; i < len; i++) {
+			char const *const p = src + i * inc;
+			uint64_t const k = sort_key(p + off, width) ^ flip;
+			sort_copy(dst + c[(k >> 8 * d) & 0xff]++ * inc, p, inc);
+		}
+		char *const t = src;
+		src = dst;
+		dst = t;
+	}
+	if (src != data) {
+		memcpy(data, src, len * inc);
+	}
+
+	return 0;
+}
+
+long darray_lower_bound(struct darray const *da, void const *key,
+		sort_comp comp)
+{
+	assert(da);
+	assert(comp);
+
+	long const inc = da->inc;
+	char const *base = da->data;
+	long n = da->len;
+	if (n == 0) {
+		return 0;
+	}
+
+	/* the first element not less than key is in [base, base + n] */
+	while (n > 1) {
+		long const half = n / 2;
+#ifdef __GNUC__
+		__builtin_prefetch(base + (n - half) / 2 * inc);
+		__builtin_prefetch(base + (half + (n - half) / 2) * inc);
+#endif
+		base = comp(key, base + half * inc) > 0 ? base + half * inc :
+			base;
+		n -= half;
+	}
+	return (base - da->data) / inc + (comp(key, base) > 0);
+}
+
+void *darray_bsearch(struct darray const *da, void const *key,
+		sort_comp comp)
+{
+	long const i = darray_lower_bound(da, key, comp);
+	char *const p = darray_at(da, i);
+
+	return p && comp(key, p) == 0 ? p : NULL;
+}
@@ -0,0 +1,83 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CDS_DARRAY_SORT_H
+#define CDS_DARRAY_SORT_H
+
+/*!
+ * \file darray_sort.h
+ * \author Jonathan Debove
+ * \brief Sorting and binary search of dynamic arrays.
+ */
+
+#include "darray.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Flag of darray_radixsort: keys are two's complement signed integers. */
+#define DARRAY_SORT_SIGNED	1
+
+/*! Arrays shorter than this are sorted by the calling thread only. */
+#define DARRAY_SORT_PARALLEL	(1L << 16)
+
+/*! darray_sort sorts the dynamic array in ascending order of `comp` with a
+ * stable merge sort run by up to `nthreads` threads, one per online
+ * processor if `nthreads <= 0`.
+ * The spare capacity of the array is used as scratch space: it is grown
+ * to twice the length first if needed, and left so.
+ * It returns `0` on success or `-ENOMEM` on out of memory; the array is
+ * unchanged then.
+ */
+int darray_sort(struct darray *da, int (*comp)(void const *, void const *),
+		int nthreads);
+
+/*! darray_radixsort sorts the dynamic array in ascending order of an
+ * integer key of `width` bytes (1, 2, 4 or 8) at offset `off` in each
+ * element, in native byte order, with a stable LSD radix sort.
+ * Keys are unsigned unless `flags` has `DARRAY_SORT_SIGNED`.
+ * Scratch space and errors are as darray_sort.
+ */
+int darray_radixsort(struct darray *da, long off, int width, int flags);
+
+/*! darray_lower_bound returns the index of the first element of the array
+ * sorted by `comp` that is not less than `key`, or the length of the array
+ * if there is none. `comp` is called as `comp(key, element)`.
+ * The search does not branch on the result of `comp`.
+ */
+long darray_lower_bound(struct darray const *da, void const *key,
+		int (*comp)(void const *, void const *));
+
+/*! darray_bsearch returns a pointer to an element of the array sorted by
+ * `comp` equal to `key`, the first one if there are several, or `NULL`.
+ */
+void *darray_bsearch(struct darray const *da, void const *key,
+		int (*comp)(void const *, void const *));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDS_DARRAY_SORT_H */
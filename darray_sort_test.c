@@ -0,0 +1,62 @@
+#include <stdio.h>
+
+#include "darray_sort.h"
+
+struct city {
+	int pop;					/* key */
+	char const *name;
+};
+
+static int city_comp(void const *a, void const *b)
+{
+	struct city const *x = a, *y = b;
+	return (x->pop > y->pop) - (x->pop < y->pop);
+}
+
+static int pop_comp(void const *key, void const *elem)	/* key first */
+{
+	int const pop = *(int const *)key;
+	struct city const *c = elem;
+	return (pop > c->pop) - (pop < c->pop);
+}
+
+int main(void)
+{
+	static struct city const cities[] = {
+		{ 2161, "Paris" }, { 8336, "New York" }, { 13960, "Tokyo" },
+		{ 1472, "Munich" }, { 3645, "Berlin" }, { 1472, "Milan" },
+	};
+	struct city *c;
+	int i;
+
+	struct darray a;
+	darray_create(&a, sizeof(*c));
+	for (i = 0; i < 6; i++) {
+		c = darray_push(&a, 1);
+		*c = cities[i];
+	}
+
+	darray_sort(&a, city_comp, 0);				/* Merge sort */
+	DARRAY_FOREACH(c, &a) {
+		printf("sort: %s %d\n", c->name, c->pop);
+	}
+
+	DARRAY_FOREACH(c, &a) {					/* Reverse */
+		c->pop = -c->pop;
+	}
+	darray_radixsort(&a, 0, sizeof(c->pop), DARRAY_SORT_SIGNED);
+	c = darray_at(&a, 0);					/* Radix sort */
+	printf("radix: first %s %d\n", c->name, c->pop);
+
+	darray_sort(&a, city_comp, 1);
+	int pop = -3000;
+	printf("lower bound %d: %ld\n", pop,			/* Search */
+			darray_lower_bound(&a, &pop, pop_comp));
+	pop = -1472;
+	c = darray_bsearch(&a, &pop, pop_comp);
+	printf("bsearch %d: %s\n", pop, c ? c->name : "none");
+
+	darray_destroy(&a);
+
+	return 0;
+}
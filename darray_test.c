@@ -1,7 +1,41 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "darray.h"
 
+DARRAY_DEFINE(ints, int)				/* Typed array */
+
+/* Bump allocator on a static buffer, blocks are never freed */
+static char arena[1 << 12];
+static size_t arena_len;
+
+static void *arena_alloc(void *context, size_t size)
+{
+	(void)context;
+	size = (size + 15) & ~(size_t)15;
+	if (size > sizeof(arena) - arena_len) {
+		return NULL;
+	}
+	arena_len += size;
+	return arena + arena_len - size;
+}
+
+static void *arena_realloc(void *context, void *ptr, size_t old, size_t size)
+{
+	void *p = arena_alloc(context, size);
+	if (p && ptr) {
+		memcpy(p, ptr, old < size ? old : size);
+	}
+	return p;
+}
+
+static void arena_free(void *context, void *ptr, size_t size)
+{
+	(void)context;
+	(void)ptr;
+	(void)size;
+}
+
 int main(void)
 {
 	int *e;
@@ -26,7 +60,42 @@ int main(void)
 		printf("at: [%d] = %d\n", i, *e);
 	}
 
+	darray_extend(&a, darray_at(&a, 0), 3);			/* Extend */
+	darray_shrink_to_fit(&a);				/* Shrink */
+	printf("extend: len %ld, cap %ld, [%ld] = %d\n", a.len, a.cap,
+			a.len - 1, *(int *)darray_at(&a, a.len - 1));
+
+	long len, cap;
+	e = darray_release(&a, &len, &cap);			/* Release */
+	e[0] = -1;
+	darray_adopt(&a, e, len, cap);				/* Adopt */
+	printf("adopt: [0] = %d\n", *(int *)darray_at(&a, 0));
+
 	darray_destroy(&a);					/* Reset */
+	darray_setgrowth(&a, 100);				/* Doubling */
+	for (i = 0; i < 100; i++) {
+		darray_push(&a, 1);
+	}
+	printf("growth: cap %ld\n", a.cap);
+	darray_destroy(&a);
+	darray_setgrowth(&a, DARRAY_GROWTH);
+
+	struct allocator al = { arena_alloc, arena_realloc, arena_free, NULL };
+	darray_setalloc(&a, &al);				/* Allocator */
+	for (i = 0; i < 100; i++) {
+		e = darray_push(&a, 1);
+		*e = i;
+	}
+	printf("arena: %ld elements in %zu bytes\n", a.len, arena_len);
+	arena_len = 0;						/* Drop all */
+
+	struct ints t;
+	ints_create(&t);
+	for (i = 0; i < 10; i++) {
+		ints_append(&t, i * i);				/* Typed push */
+	}
+	printf("typed: [%d] = %d\n", 3, *ints_at(&t, 3));
+	ints_destroy(&t);
 
 	return 0;
 }
@@ -0,0 +1,210 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ddeque.h"
+
+#ifdef __GNUC__
+#	define SPSC_LOAD(p)	__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#	define SPSC_STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#	error "ddeque_spsc needs the __atomic builtins"
+#endif
+
+void ddeque_create(struct ddeque *dq, long inc)
+{
+	assert(dq);
+	assert(inc > 0);
+
+	dq->data = NULL;
+	dq->head = 0;
+	dq->len = 0;
+	dq->cap = 0;
+	dq->inc = inc;
+	dq->alloc = NULL;
+}
+
+int ddeque_setalloc(struct ddeque *dq, struct allocator const *alloc)
+{
+	assert(dq);
+
+	if (dq->len > 0) {
+		return -EBUSY;
+	}
+	ddeque_destroy(dq);
+	dq->alloc = alloc;
+	return 0;
+}
+
+void ddeque_destroy(struct ddeque *dq)
+{
+	assert(dq);
+
+	allocator_free(dq->alloc, dq->data, dq->cap * dq->inc);
+	dq->data = NULL;
+	dq->head = 0;
+	dq->len = 0;
+	dq->cap = 0;
+}
+
+int ddeque_setcap(struct ddeque *dq, long cap)
+{
+	assert(dq);
+	assert(cap >= 0);
+	assert(cap <= LONG_MAX / dq->inc);
+
+	if (cap == 0) {
+		ddeque_destroy(dq);
+		return 0;
+	}
+
+	long const inc = dq->inc;
+	long const len = dq->len < cap ? dq->len : cap;
+	long const front = dq->cap - dq->head < len ? dq->cap - dq->head : len;
+	long const back = len - front;	/* wrapped to the start of the ring */
+	char *data;
+
+	if (back > 0) {
+		/* straighten the ring into a new block */
+		data = allocator_alloc(dq->alloc, cap * inc);
+		if (!data) {
+			return -ENOMEM;
+		}
+		memcpy(data, dq->data + dq->head * inc, front * inc);
+		memcpy(data + front * inc, dq->data, back * inc);
+		allocator_free(dq->alloc, dq->data, dq->cap * inc);
+	} else {
+		if (dq->head + len > cap) {
+			memmove(dq->data, dq->data + dq->head * inc, len * inc);
+			dq->head = 0;
+		}
+		data = allocator_realloc(dq->alloc, dq->data,
+				dq->cap * inc, cap * inc);
+		if (!data) {
+			return -ENOMEM;
+		}
+	}
+	dq->data = data;
+	dq->head = back > 0 ? 0 : dq->head;
+	dq->len = len;
+	dq->cap = cap;
+	return 0;
+}
+
+int ddeque_spsc_create(struct ddeque_spsc *q, long inc, long cap,
+		struct allocator const *alloc)
+{
+	assert(q);
+	assert(inc > 0);
+	assert(cap > 0);
+
+	unsigned long size = 1;
+	while (size < (unsigned long)cap) {
+		if (size > (unsigned long)LONG_MAX / 2 / inc) {
+			return -ENOMEM;
+		}
+		size *= 2;
+	}
+
+	q->data = allocator_alloc(alloc, size * inc);
+	if (!q->data) {
+		return -ENOMEM;
+	}
+	q->mask = size - 1;
+	q->inc = inc;
+	q->alloc = alloc;
+	q->tail = 0;
+	q->head_cache = 0;
+	q->head = 0;
+	q->tail_cache = 0;
+	return 0;
+}
+
+void ddeque_spsc_destroy(struct ddeque_spsc *q)
+{
+	assert(q);
+
+	allocator_free(q->alloc, q->data, (q->mask + 1) * q->inc);
+	q->data = NULL;
+}
+
+long ddeque_spsc_push(struct ddeque_spsc *q, void const *src, long n)
+{
+	assert(q);
+	assert(n >= 0);
+
+	unsigned long const size = q->mask + 1;
+	unsigned long const tail = q->tail;
+	if (size - (tail - q->head_cache) < (unsigned long)n) {
+		q->head_cache = SPSC_LOAD(&q->head);
+	}
+	unsigned long const room = size - (tail - q->head_cache);
+	if ((unsigned long)n > room) {
+		n = room;
+	}
+
+	long const inc = q->inc;
+	unsigned long const i = tail & q->mask;
+	long const first = size - i < (unsigned long)n ? (long)(size - i) : n;
+	memcpy(q->data + i * inc, src, first * inc);
+	memcpy(q->data, (char const *)src + first * inc, (n - first) * inc);
+	SPSC_STORE(&q->tail, tail + n);
+	return n;
+}
+
+long ddeque_spsc_pop(struct ddeque_spsc *q, void *dst, long n)
+{
+	assert(q);
+	assert(n >= 0);
+
+	unsigned long const head = q->head;
+	if (q->tail_cache - head < (unsigned long)n) {
+		q->tail_cache = SPSC_LOAD(&q->tail);
+	}
+	unsigned long const avail = q->tail_cache - head;
+	if ((unsigned long)n > avail) {
+		n = avail;
+	}
+
+	long const inc = q->inc;
+	unsigned long const size = q->mask + 1;
+	unsigned long const i = head & q->mask;
+	long const first = size - i < (unsigned long)n ? (long)(size - i) : n;
+	memcpy(dst, q->data + i * inc, first * inc);
+	memcpy((char *)dst + first * inc, q->data, (n - first) * inc);
+	SPSC_STORE(&q->head, head + n);
+	return n;
+}
+
+extern void *ddeque_at(struct ddeque const *dq, long i);
+extern int ddeque__grow(struct ddeque *dq);
+extern void *ddeque_push_back(struct ddeque *dq);
+extern void *ddeque_push_front(struct ddeque *dq);
+extern void *ddeque_pop_back(struct ddeque *dq);
+extern void *ddeque_pop_front(struct ddeque *dq);
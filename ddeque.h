@@ -0,0 +1,217 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CDS_DDEQUE_H
+#define CDS_DDEQUE_H
+
+/*!
+ * \file ddeque.h
+ * \author Jonathan Debove
+ * \brief Generic double-ended queue on a growable ring buffer.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "allocator.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Generic double-ended queue.
+ * The `len` elements start at index `head` of a ring of `cap` elements.
+ * Do not modify its fields unless you know what you are doing.
+ */
+struct ddeque {
+	char *data;
+	long head;
+	long len;
+	long cap;
+	long inc;
+	struct allocator const *alloc;	/* NULL for malloc	*/
+};
+
+/*! ddeque_create initializes a deque `dq` of element of size `inc`.
+ * It cannot fail and does not allocate memory.
+ */
+void ddeque_create(struct ddeque *dq, long inc);
+
+/*! ddeque_setalloc sets the allocator of an empty deque, whose memory is
+ * released first. `NULL` restores `malloc`, `realloc` and `free`.
+ * It returns `0` on success or `-EBUSY` if the deque is not empty.
+ */
+int ddeque_setalloc(struct ddeque *dq, struct allocator const *alloc);
+
+/*! ddeque_destroy frees the memory space internal to the deque.
+ * On output, the deque is empty and in a valid state.
+ */
+void ddeque_destroy(struct ddeque *dq);
+
+/*! ddeque_setcap sets the maximum capacity of the deque, dropping the last
+ * elements if it is lower than the length. The elements are made
+ * contiguous: a wrapped ring is straightened by a single copy on growth.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int ddeque_setcap(struct ddeque *dq, long cap);
+
+/*! ddeque_at returns a pointer to the `i`th element from the front.
+ * Returns `NULL` if index is out of bounds.
+ */
+inline
+void *ddeque_at(struct ddeque const *dq, long i)
+{
+	assert(dq);
+
+	if (i < 0 || i >= dq->len) {
+		return NULL;
+	}
+	i += dq->head;
+	i -= i >= dq->cap ? dq->cap : 0;
+	return dq->data + i * dq->inc;
+}
+
+/* ddeque__grow grows a full deque (private) */
+inline
+int ddeque__grow(struct ddeque *dq)
+{
+	/* test overflow */
+	long grow = dq->cap / 2 + 8;
+	grow = dq->cap <= LONG_MAX - grow ? dq->cap + grow : LONG_MAX;
+	return ddeque_setcap(dq, grow);
+}
+
+/*! ddeque_push_back appends an element after the last one.
+ * Returns the pointer to the new element, or `NULL` if out of memory.
+ */
+inline
+void *ddeque_push_back(struct ddeque *dq)
+{
+	assert(dq);
+
+	if (dq->len == dq->cap && ddeque__grow(dq)) {
+		return NULL;
+	}
+	dq->len++;
+	return ddeque_at(dq, dq->len - 1);
+}
+
+/*! ddeque_push_front inserts an element before the first one.
+ * Returns the pointer to the new element, or `NULL` if out of memory.
+ */
+inline
+void *ddeque_push_front(struct ddeque *dq)
+{
+	assert(dq);
+
+	if (dq->len == dq->cap && ddeque__grow(dq)) {
+		return NULL;
+	}
+	dq->head = (dq->head > 0 ? dq->head : dq->cap) - 1;
+	dq->len++;
+	return dq->data + dq->head * dq->inc;
+}
+
+/*! ddeque_pop_back removes the last element.
+ * Returns a pointer to the removed element, valid until the next push,
+ * or `NULL` if the deque is empty.
+ */
+inline
+void *ddeque_pop_back(struct ddeque *dq)
+{
+	assert(dq);
+
+	if (dq->len == 0) {
+		return NULL;
+	}
+	long i = dq->head + --dq->len;
+	i -= i >= dq->cap ? dq->cap : 0;
+	return dq->data + i * dq->inc;
+}
+
+/*! ddeque_pop_front removes the first element.
+ * Returns a pointer to the removed element, valid until the next push,
+ * or `NULL` if the deque is empty.
+ */
+inline
+void *ddeque_pop_front(struct ddeque *dq)
+{
+	assert(dq);
+
+	if (dq->len == 0) {
+		return NULL;
+	}
+	char *const p = dq->data + dq->head * dq->inc;
+	dq->head = dq->head + 1 < dq->cap ? dq->head + 1 : 0;
+	dq->len--;
+	return p;
+}
+
+/*! Bounded single-producer single-consumer queue.
+ * One thread may push while another one pops, without locks.
+ * The capacity is a power of two fixed at creation.
+ */
+struct ddeque_spsc {
+	/* private */
+	char *data;
+	unsigned long mask;	/* capacity - 1		*/
+	long inc;
+	struct allocator const *alloc;
+	char pad0[64];
+	unsigned long tail;	/* written by the producer	*/
+	unsigned long head_cache;
+	char pad1[64];
+	unsigned long head;	/* written by the consumer	*/
+	unsigned long tail_cache;
+	char pad2[64];
+};
+
+/*! ddeque_spsc_create initializes a queue of at least `cap` elements of
+ * size `inc`, allocated with `alloc` (`NULL` for `malloc`).
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int ddeque_spsc_create(struct ddeque_spsc *q, long inc, long cap,
+		struct allocator const *alloc);
+
+/*! ddeque_spsc_destroy frees the queue, which must not be in use. */
+void ddeque_spsc_destroy(struct ddeque_spsc *q);
+
+/*! ddeque_spsc_push copies up to `n` elements from `src` at the back of
+ * the queue. Only one thread may push.
+ * It returns the number of elements pushed, `0` if the queue is full.
+ */
+long ddeque_spsc_push(struct ddeque_spsc *q, void const *src, long n);
+
+/*! ddeque_spsc_pop moves up to `n` elements from the front of the queue
+ * to `dst`. Only one thread may pop.
+ * It returns the number of elements popped, `0` if the queue is empty.
+ */
+long ddeque_spsc_pop(struct ddeque_spsc *q, void *dst, long n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDS_DDEQUE_H */
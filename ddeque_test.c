@@ -0,0 +1,90 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+
+#include "ddeque.h"
+
+#define NITEMS (1600 * BATCH)
+#define BATCH 64
+
+struct ddeque_spsc q;
+
+void *producer(void *arg)
+{
+	int batch[BATCH];
+	int n = 0, i;
+
+	(void)arg;	/* unused */
+	while (n < NITEMS) {
+		for (i = 0; i < BATCH; i++) {
+			batch[i] = n + i;
+		}
+		long done = 0;
+		while (done < BATCH) {				/* Push batch */
+			long const k = ddeque_spsc_push(&q, batch + done,
+					BATCH - done);
+			if (k == 0) {
+				sched_yield();			/* Full */
+			}
+			done += k;
+		}
+		n += BATCH;
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	int *e;
+	int i;
+
+	struct ddeque dq;					/* Deque */
+	ddeque_create(&dq, sizeof(*e));				/* Initialization */
+
+	for (i = 0; i < 5; i++) {
+		e = ddeque_push_back(&dq);			/* Push back */
+		*e = i;
+		e = ddeque_push_front(&dq);			/* Push front */
+		*e = -i;
+	}
+
+	e = ddeque_pop_front(&dq);				/* Pop front */
+	printf("pop front: %d\n", *e);
+	e = ddeque_pop_back(&dq);				/* Pop back */
+	printf("pop back: %d\n", *e);
+
+	for (i = 0; i < dq.len; i++) {				/* Traversal */
+		e = ddeque_at(&dq, i);
+		printf("at: [%d] = %d\n", i, *e);
+	}
+
+	long sum = 0;
+	for (i = 0; i < 1000; i++) {				/* Work queue */
+		*(int *)ddeque_push_back(&dq) = i;
+		sum += *(int *)ddeque_pop_front(&dq);
+	}
+	printf("queue: sum %ld, len %ld, cap %ld\n", sum, dq.len, dq.cap);
+
+	ddeque_destroy(&dq);					/* Reset */
+
+	ddeque_spsc_create(&q, sizeof(int), 1000, NULL);	/* SPSC queue */
+	pthread_t thread;
+	pthread_create(&thread, NULL, producer, NULL);
+
+	int batch[BATCH];
+	int n = 0, ok = 1;
+	while (n < NITEMS) {
+		long const k = ddeque_spsc_pop(&q, batch, BATCH);	/* Pop */
+		if (k == 0) {
+			sched_yield();				/* Empty */
+		}
+		for (i = 0; i < k; i++) {
+			ok &= batch[i] == n++;
+		}
+	}
+	pthread_join(thread, NULL);
+	printf("spsc: %d items in order: %d\n", n, ok);
+	ddeque_spsc_destroy(&q);
+
+	return 0;
+}
@@ -0,0 +1,212 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include "dheap.h"
+
+/* Elements are moved into a hole rather than swapped: the element being
+ * sifted stays aside until its final index is known.
+ */
+
+/* memcpy of a constant size, for the common element sizes */
+static inline
+void heap_copy(char *dst, char const *src, long inc)
+{
+	switch (inc) {
+	case 4:
+		memcpy(dst, src, 4);
+		break;
+	case 8:
+		memcpy(dst, src, 8);
+		break;
+	case 16:
+		memcpy(dst, src, 16);
+		break;
+	default:
+		memcpy(dst, src, inc);
+	}
+}
+
+/* heap_place stores e at index i */
+static inline
+void heap_place(struct dheap *h, long i, void const *e)
+{
+	char *const p = h->da.data + i * h->da.inc;
+	heap_copy(p, e, h->da.inc);
+	if (h->moved) {
+		h->moved(p, i);
+	}
+}
+
+/* heap_up moves the hole i up until e fits, and returns its index */
+static
+long heap_up(struct dheap *h, long i, void const *e)
+{
+	long const inc = h->da.inc;
+	char *const a = h->da.data;
+
+	while (i > 0) {
+		long const p = (i - 1) / DHEAP_ARITY;
+		if (h->comp(e, a + p * inc) >= 0) {
+			break;
+		}
+		heap_place(h, i, a + p * inc);
+		i = p;
+	}
+	return i;
+}
+
+/* heap_down moves the hole i down until e fits, and returns its index */
+static
+long heap_down(struct dheap *h, long i, void const *e)
+{
+	long const inc = h->da.inc;
+	long const len = h->da.len;
+	char *const a = h->da.data;
+
+	for (;;) {
+		long const c = DHEAP_ARITY * i + 1;
+		if (c >= len) {
+			break;
+		}
+		long const end = len - c < DHEAP_ARITY ? len : c + DHEAP_ARITY;
+		long m = c, j;
+		for (j = c + 1; j < end; j++) {
+			m = h->comp(a + j * inc, a + m * inc) < 0 ? j : m;
+		}
+		if (h->comp(a + m * inc, e) >= 0) {
+			break;
+		}
+		heap_place(h, i, a + m * inc);
+		i = m;
+	}
+	return i;
+}
+
+void dheap_create(struct dheap *h, long inc,
+		int (*comp)(void const *, void const *),
+		void (*moved)(void *, long))
+{
+	assert(h);
+	assert(comp);
+
+	darray_create(&h->da, inc);
+	h->comp = comp;
+	h->moved = moved;
+}
+
+void dheap_destroy(struct dheap *h)
+{
+	assert(h);
+
+	darray_destroy(&h->da);
+}
+
+int dheap_push(struct dheap *h, void const *elem)
+{
+	assert(h);
+	assert(elem);
+
+	if (!darray_push(&h->da, 1)) {
+		return -ENOMEM;
+	}
+	heap_place(h, heap_up(h, h->da.len - 1, elem), elem);
+	return 0;
+}
+
+int dheap_pop(struct dheap *h, void *out)
+{
+	assert(h);
+
+	if (h->da.len == 0) {
+		return -ENOENT;
+	}
+	dheap_remove(h, 0, out);
+	return 0;
+}
+
+void dheap_update(struct dheap *h, long i, void const *elem)
+{
+	assert(h);
+	assert(i >= 0 && i < h->da.len);
+	assert((char const *)elem < h->da.data || (char const *)elem >=
+			h->da.data + h->da.len * h->da.inc);
+
+	long j = heap_up(h, i, elem);
+	if (j == i) {
+		j = heap_down(h, i, elem);
+	}
+	heap_place(h, j, elem);
+}
+
+void dheap_remove(struct dheap *h, long i, void *out)
+{
+	assert(h);
+	assert(i >= 0 && i < h->da.len);
+
+	if (out) {
+		memcpy(out, h->da.data + i * h->da.inc, h->da.inc);
+	}
+	/* the last element stays in the spare capacity while it is sifted */
+	char const *const last = darray_pop(&h->da, 1);
+	if (i < h->da.len) {
+		dheap_update(h, i, last);
+	}
+}
+
+int dheap_heapify(struct dheap *h)
+{
+	assert(h);
+
+	long const len = h->da.len;
+	long const inc = h->da.inc;
+	if (len < 2) {
+		return 0;
+	}
+	if (h->da.cap == len && darray_setcap(&h->da, len + 1)) {
+		return -ENOMEM;
+	}
+
+	/* leaves are not moved: report all the indices once at the end */
+	void (*const moved)(void *, long) = h->moved;
+	char *const tmp = h->da.data + len * inc;
+	long i;
+	h->moved = NULL;
+	for (i = (len - 2) / DHEAP_ARITY; i >= 0; i--) {
+		heap_copy(tmp, h->da.data + i * inc, inc);
+		heap_place(h, heap_down(h, i, tmp), tmp);
+	}
+	h->moved = moved;
+	if (moved) {
+		for (i = 0; i < len; i++) {
+			moved(h->da.data + i * inc, i);
+		}
+	}
+	return 0;
+}
+
+extern void *dheap_peek(struct dheap const *h);
@@ -0,0 +1,105 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CDS_DHEAP_H
+#define CDS_DHEAP_H
+
+/*!
+ * \file dheap.h
+ * \author Jonathan Debove
+ * \brief Priority queue on a dynamic array.
+ */
+
+#include "darray.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Number of children of a node. */
+#define DHEAP_ARITY	4
+
+/*! 4-ary min-heap of the elements of a dynamic array.
+ * The element `a` is above `b` if `comp(a, b) < 0`. If `moved` is not
+ * `NULL`, it is called with every element stored at a new index `i`,
+ * for instance to record it for dheap_update.
+ * The elements are in `da`, which may be filled and then given to
+ * dheap_heapify.
+ */
+struct dheap {
+	struct darray da;
+	int (*comp)(void const *a, void const *b);
+	void (*moved)(void *elem, long i);
+};
+
+/*! dheap_create initializes an empty heap of elements of size `inc`.
+ * It cannot fail and does not allocate memory.
+ */
+void dheap_create(struct dheap *h, long inc,
+		int (*comp)(void const *, void const *),
+		void (*moved)(void *, long));
+
+/*! dheap_destroy frees the memory space internal to the heap. */
+void dheap_destroy(struct dheap *h);
+
+/*! dheap_peek returns a pointer to the top element, or `NULL` if the heap
+ * is empty. The element must not be modified.
+ */
+inline
+void *dheap_peek(struct dheap const *h)
+{
+	return darray_data(&h->da);
+}
+
+/*! dheap_push copies `elem`, which must not be in the heap, to the heap.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int dheap_push(struct dheap *h, void const *elem);
+
+/*! dheap_pop removes the top element and copies it to `out` if it is not
+ * `NULL`. It returns `0` on success or `-ENOENT` if the heap is empty.
+ */
+int dheap_pop(struct dheap *h, void *out);
+
+/*! dheap_update replaces the element at index `i` by `elem`, which must
+ * not be in the heap, and moves it up or down, e.g. to decrease its key.
+ */
+void dheap_update(struct dheap *h, long i, void const *elem);
+
+/*! dheap_remove removes the element at index `i` and copies it to `out`
+ * if it is not `NULL`.
+ */
+void dheap_remove(struct dheap *h, long i, void *out);
+
+/*! dheap_heapify orders the elements of `h->da` as a heap in linear time.
+ * It needs one spare element of capacity.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int dheap_heapify(struct dheap *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDS_DHEAP_H */
@@ -0,0 +1,64 @@
+#include <stdio.h>
+
+#include "dheap.h"
+
+struct timer {
+	long deadline;					/* key */
+	int id;
+};
+
+long position[4];					/* index of each timer */
+
+int timer_comp(void const *a, void const *b)
+{
+	struct timer const *x = a, *y = b;
+	return (x->deadline > y->deadline) - (x->deadline < y->deadline);
+}
+
+void timer_moved(void *elem, long i)
+{
+	position[((struct timer *)elem)->id] = i;
+}
+
+int main(void)
+{
+	static long const deadlines[] = { 300, 100, 400, 200 };
+	struct timer t;
+	int i;
+
+	struct dheap h;						/* Heap */
+	dheap_create(&h, sizeof(t), timer_comp, timer_moved);
+
+	for (i = 0; i < 4; i++) {				/* Push */
+		t.deadline = deadlines[i];
+		t.id = i;
+		dheap_push(&h, &t);
+	}
+
+	struct timer const *top = dheap_peek(&h);		/* Peek */
+	printf("peek: timer %d at %ld\n", top->id, top->deadline);
+
+	t.deadline = 50;					/* Decrease key */
+	t.id = 2;
+	dheap_update(&h, position[2], &t);
+
+	dheap_remove(&h, position[3], &t);			/* Cancel */
+	printf("cancel: timer %d\n", t.id);
+
+	while (dheap_pop(&h, &t) == 0) {			/* Pop */
+		printf("pop: timer %d at %ld\n", t.id, t.deadline);
+	}
+
+	for (i = 0; i < 4; i++) {				/* Bulk load */
+		t.deadline = deadlines[i];
+		t.id = i;
+		*(struct timer *)darray_push(&h.da, 1) = t;
+	}
+	dheap_heapify(&h);					/* Heapify */
+	top = dheap_peek(&h);
+	printf("heapify: timer %d at %ld\n", top->id, top->deadline);
+
+	dheap_destroy(&h);					/* Reset */
+
+	return 0;
+}
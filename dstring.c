@@ -22,14 +22,21 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <math.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
 
 #include "dstring.h"
+#include "fnv1a.h"
+#include "wyhash.h"
 
 extern void dstring_create(struct dstring *s);
+extern int dstring_setalloc(struct dstring *s, struct allocator const *alloc);
 extern void dstring_destroy(struct dstring *s);
 
 extern int dstring_setcap(struct dstring *s, long cap);
+extern int dstring_reserve(struct dstring *s, long n);
 extern int dstring_setlen(struct dstring *s, long len);
 
 extern int dstring_chomp(struct dstring *s);
@@ -44,6 +51,13 @@ extern long dstring_len(struct dstring const *s);
 
 extern int dstring_compare(struct dstring const *s1, struct dstring const *s2);
 
+extern struct dstring_view dstring_view(struct dstring const *s);
+extern int dstring_view_compare(struct dstring_view v1, struct dstring_view v2);
+extern struct dstring_view dstring_find(struct dstring_view v, char const *str,
+		long len);
+extern int dstring_next_token(struct dstring_view *rest, char delim,
+		struct dstring_view *token);
+
 int dstring_vconcatf(struct dstring *s, char const *fmt, va_list ap)
 {
 	assert(s);
@@ -53,7 +67,7 @@ int dstring_vconcatf(struct dstring *s, char const *fmt, va_list ap)
 	va_list args;
 
 	va_copy(args, ap);
-	int n = vsnprintf(s->str + len, s->cap - len, fmt, args);
+	int n = vsnprintf(DSTRING_DATA(s) + len, s->cap - len, fmt, args);
 	va_end(args);
 	if (n < 0) {
 		return -EINVAL;
@@ -69,10 +83,233 @@ int dstring_vconcatf(struct dstring *s, char const *fmt, va_list ap)
 	}
 
 	va_copy(args, ap);
-	n = vsnprintf(s->str + len, s->cap - len, fmt, ap);
+	n = vsnprintf(DSTRING_DATA(s) + len, s->cap - len, fmt, ap);
 	va_end(args);
 
 	assert(n == s->len - len);
 	return 0;
 }
 
+static char const digits[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static int u64_len(uint64_t x)
+{
+	int n = 1;
+	for (;;) {
+		if (x < 10) {
+			return n;
+		} else if (x < 100) {
+			return n + 1;
+		} else if (x < 1000) {
+			return n + 2;
+		} else if (x < 10000) {
+			return n + 3;
+		}
+		x /= 10000;
+		n += 4;
+	}
+}
+
+/* Writes the decimal digits of `x` backwards from `end`, two at a time. */
+static char *u64_write(char *end, uint64_t x)
+{
+	while (x >= 100) {
+		unsigned const i = (unsigned)(x % 100) * 2;
+		x /= 100;
+		*--end = digits[i + 1];
+		*--end = digits[i];
+	}
+	if (x >= 10) {
+		*--end = digits[x * 2 + 1];
+		*--end = digits[x * 2];
+	} else {
+		*--end = '0' + (char)x;
+	}
+	return end;
+}
+
+/* Appends `n` characters to `s` and returns a pointer to the first one. */
+static char *append(struct dstring *s, long n)
+{
+	long const len = s->len;
+	if (dstring_setlen(s, len + n)) {
+		return NULL;
+	}
+	return DSTRING_DATA(s) + len;
+}
+
+int dstring_concat_u64(struct dstring *s, uint64_t x)
+{
+	assert(s);
+
+	int const n = u64_len(x);
+	char *const p = append(s, n);
+	if (!p) {
+		return -ENOMEM;
+	}
+	u64_write(p + n, x);
+	return 0;
+}
+
+int dstring_concat_i64(struct dstring *s, int64_t x)
+{
+	assert(s);
+
+	uint64_t const u = x < 0 ? 0 - (uint64_t)x : (uint64_t)x;
+	int const n = u64_len(u) + (x < 0);
+	char *const p = append(s, n);
+	if (!p) {
+		return -ENOMEM;
+	}
+	u64_write(p + n, u);
+	if (x < 0) {
+		*p = '-';
+	}
+	return 0;
+}
+
+int dstring_concat_hex(struct dstring *s, uint64_t x)
+{
+	assert(s);
+
+	int n = 1;
+	while (n < 16 && x >> (4 * n)) {
+		n++;
+	}
+	char *const p = append(s, n);
+	if (!p) {
+		return -ENOMEM;
+	}
+	char *end = p + n;
+	do {
+		*--end = "0123456789abcdef"[x & 0xf];
+		x >>= 4;
+	} while (end != p);
+	return 0;
+}
+
+int dstring_concat_double(struct dstring *s, double x)
+{
+	assert(s);
+
+	/* Powers of ten are exact doubles up to 1e22: if the integer m < 2^53
+	 * divided by 10^k rounds to x, then the decimal m.10^-k also reads
+	 * back to x, both being the correctly rounded value of the same
+	 * number. The smallest such k gives the fewest digits.
+	 */
+	static double const pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+		1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+	};
+	int const nk = sizeof(pow10) / sizeof(pow10[0]);
+	double const two53 = 9007199254740992.0;
+	double const a = x < 0 ? -x : x;
+	int const neg = signbit(x) != 0;
+	int k;
+	for (k = 0; k < nk && a * pow10[k] < two53; k++) {
+		uint64_t const m = (uint64_t)(a * pow10[k] + 0.5);
+		if ((double)m / pow10[k] != a) {
+			continue;
+		}
+
+		uint64_t const p = (uint64_t)pow10[k];
+		int const ni = u64_len(m / p);
+		int const n = neg + ni + (k > 0) + k;
+		char *const q = append(s, n);
+		if (!q) {
+			return -ENOMEM;
+		}
+		if (neg) {
+			*q = '-';
+		}
+		u64_write(q + neg + ni, m / p);
+		if (k > 0) {
+			/* zero padded fraction */
+			char *const end = q + n;
+			char *f = u64_write(end, m % p + p);
+			f[0] = '.';
+		}
+		return 0;
+	}
+
+	if (isnan(x)) {
+		return dstring_concat(s, "nan", 3);
+	} else if (isinf(x)) {
+		return neg ? dstring_concat(s, "-inf", 4) :
+			dstring_concat(s, "inf", 3);
+	}
+
+	/* many digits or exponent, the first precision that reads back:
+	 * 15 digits or less always do when a shorter decimal does, but for
+	 * subnormal numbers
+	 */
+	char buf[32];
+	int n = 0;
+	int prec;
+	for (prec = 15; prec <= 17; prec++) {
+		n = snprintf(buf, sizeof(buf), "%.*g", prec, x);
+		if (strtod(buf, NULL) == x) {
+			break;
+		}
+	}
+	return dstring_concat(s, buf, n);
+}
+
+unsigned long dstring_fnv1a(struct dstring const *s)
+{
+	assert(s);
+
+	return fnv1a_mem(dstring_str(s), s->len);
+}
+
+unsigned long dstring_hash(void const *s, unsigned long seed)
+{
+	struct dstring const *ds = (struct dstring const *)s;
+	assert(ds);
+
+	return wyhash_mem(dstring_str(ds), ds->len, seed);
+}
+
+long dstring_split(struct dstring_view v, char delim,
+		struct dstring_view *fields, long max)
+{
+	assert(fields || max == 0);
+	assert(max >= 0);
+
+	long n = 0;
+	while (n < max - 1 && dstring_next_token(&v, delim, &fields[n])) {
+		n++;
+	}
+	if (n == max - 1 && v.p) {
+		fields[n++] = v;
+	}
+	return n;
+}
+
+unsigned long dstring_view_hash(void const *v, unsigned long seed)
+{
+	struct dstring_view const *dv = (struct dstring_view const *)v;
+	assert(dv);
+
+	return wyhash_mem(dv->p, dv->len, seed);
+}
+
+int dstring_view_comp(void const *key, void const *entry)
+{
+	struct dstring_view const *v1 = (struct dstring_view const *)key;
+	struct dstring_view const *v2 = (struct dstring_view const *)entry;
+	assert(v1);
+	assert(v2);
+
+	return v1->len != v2->len || memcmp(v1->p, v2->p, v1->len) != 0;
+}
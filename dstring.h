@@ -37,8 +37,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <string.h>
 
+#include "allocator.h"
+
 #ifndef DSTRING_NEGATIVE_INDEX
 /*! Flag to allow negative indexing to access the end of the string. */
 #define DSTRING_NEGATIVE_INDEX	1
@@ -48,17 +51,35 @@
 extern "C" {
 #endif
 
-/*! Dynamic string. */
+#ifndef DSTRING_SMALL
+/*! Size of the inline buffer holding short strings, `DSTRING_SMALL - 1`
+ * characters and the null byte. It must be at least `sizeof(char *)`.
+ */
+#define DSTRING_SMALL	24
+#endif
+
+/*! Dynamic string.
+ * Strings shorter than `DSTRING_SMALL` are stored inline and never allocate,
+ * longer ones on the heap: `cap > DSTRING_SMALL` tells the latter.
+ * The string does not point to itself, so it can be moved with `memcpy`.
+ */
 struct dstring {
 	/* private */
-	char *str;
+	union {
+		char *ptr;			/* cap > DSTRING_SMALL	*/
+		char buf[DSTRING_SMALL];	/* otherwise		*/
+	} str;
 	long len;
-	long cap;
+	long cap;			/* 0 or DSTRING_SMALL if inline	*/
+	struct allocator const *alloc;	/* NULL for malloc	*/
 	//int err;
-	//char scratch[64];
 };
 
-#define DSTRING() {.str = NULL, .len = 0, .cap = 0}
+#define DSTRING() {.str = {.buf = ""}, .len = 0, .cap = 0, .alloc = NULL}
+
+/* Pointer to the characters of a string. */
+#define DSTRING_DATA(s)	((s)->cap > DSTRING_SMALL ?			\
+		(s)->str.ptr : (char *)(s)->str.buf)
 
 /*! dstring_create initializes a dynamic string `s`.
  * It cannot fail and does not allocate memory.
@@ -68,24 +89,53 @@ void dstring_create(struct dstring *s)
 {
 	assert(s);
 
-	s->str = NULL;
+	s->str.buf[0] = '\0';
 	s->cap = 0;
 	s->len = 0;
+	s->alloc = NULL;
 }
 
 /*! dstring_destroy frees the memory space internal to the dynamic string.
  * On output, the dynamic string is empty and in a valid state.
+ * The allocator is kept.
  */
 inline
 void dstring_destroy(struct dstring *s)
 {
 	assert(s);
 
-	free(s->str);
-	dstring_create(s);
+	/* no allocator_free, static functions cannot be used here */
+	if (s->cap <= DSTRING_SMALL) {
+		/* inline */
+	} else if (!s->alloc) {
+		free(s->str.ptr);
+	} else {
+		s->alloc->deallocate(s->alloc->context, s->str.ptr, s->cap);
+	}
+	s->str.buf[0] = '\0';
+	s->cap = 0;
+	s->len = 0;
+}
+
+/*! dstring_setalloc sets the allocator of an empty dynamic string, whose
+ * memory is released first. `NULL` restores `malloc`, `realloc` and `free`.
+ * It returns `0` on success or `-EBUSY` if the string is not empty.
+ */
+inline
+int dstring_setalloc(struct dstring *s, struct allocator const *alloc)
+{
+	assert(s);
+
+	if (s->len > 0) {
+		return -EBUSY;
+	}
+	dstring_destroy(s);
+	s->alloc = alloc;
+	return 0;
 }
 
 /*! dstring_setcap sets the maximum capacity of the dynamic string.
+ * Up to `DSTRING_SMALL`, the inline buffer is used.
  * It returns `0` on success or `-ENOMEM` on out of memory.
  */
 inline
@@ -98,18 +148,69 @@ int dstring_setcap(struct dstring *s, long cap)
 		return 0;
 	}
 
-	char *str = (char *)realloc(s->str, cap);  // C++ cast
-	if (str) {
-		s->str = str;
-		s->cap = cap;
-		if (s->len > cap - 1) {
-			s->len = cap - 1;
-			s->str[s->len] = '\0';
+	long const len = s->len < cap - 1 ? s->len : cap - 1;
+	if (cap <= DSTRING_SMALL) {
+		if (s->cap > DSTRING_SMALL) {
+			char tmp[DSTRING_SMALL];
+			memcpy(tmp, s->str.ptr, len);
+			dstring_destroy(s);
+			memcpy(s->str.buf, tmp, len);
 		}
+		s->cap = DSTRING_SMALL;
+		s->len = len;
+		s->str.buf[len] = '\0';
 		return 0;
 	}
 
-	return -ENOMEM;
+	/* no allocator_realloc, static functions cannot be used here */
+	char *str;
+	if (s->cap > DSTRING_SMALL) {
+		str = (char *)(s->alloc ?  // C++ cast
+				s->alloc->reallocate(s->alloc->context,
+					s->str.ptr, s->cap, cap) :
+				realloc(s->str.ptr, cap));
+	} else {
+		/* spill to the heap */
+		str = (char *)(s->alloc ?
+				s->alloc->allocate(s->alloc->context, cap) :
+				malloc(cap));
+		if (str) {
+			memcpy(str, s->str.buf, s->len + 1);
+		}
+	}
+	if (!str) {
+		return -ENOMEM;
+	}
+
+	s->str.ptr = str;
+	s->cap = cap;
+	if (s->len > len) {
+		s->len = len;
+		str[len] = '\0';
+	}
+	return 0;
+}
+
+/*! dstring_reserve makes room for `n` more characters: until the length
+ * grows by more than `n`, the string is not reallocated, so several pieces
+ * can be appended after a single capacity check.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+inline
+int dstring_reserve(struct dstring *s, long n)
+{
+	assert(s);
+	assert(n >= 0 && n < LONG_MAX - s->len);
+
+	long const len = s->len + n;
+	if (len <= s->cap - 1) {
+		return 0;
+	}
+
+	/* test overflow */
+	long grow = s->cap / 2 + 4;
+	grow = s->cap <= LONG_MAX - grow ? s->cap + grow : len + 1;
+	return dstring_setcap(s, grow > len ? grow : len + 1);
 }
 
 /*! dstring_setlen sets the number of characters of the dynamic string.
@@ -126,17 +227,14 @@ int dstring_setlen(struct dstring *s, long len)
 	}
 
 	if (len > s->cap - 1) {
-		/* test overflow */
-		long grow = s->cap / 2 + 4;
-		grow = s->cap <= LONG_MAX - grow ? s->cap + grow : len + 1;
-		int err = dstring_setcap(s, grow > len ? grow : len + 1);
+		int err = dstring_reserve(s, len - s->len);
 		if (err) {
 			return err;
 		}
 	}
 
 	s->len = len;
-	s->str[len] = '\0';
+	DSTRING_DATA(s)[len] = '\0';
 
 	return 0;
 }
@@ -149,13 +247,14 @@ int dstring_chomp(struct dstring *s)
 {
 	assert(s);
 
+	char *const str = DSTRING_DATA(s);
 	int n = 0;
-	if (s->len > 0 && s->str[s->len - 1] == '\n') {
-		s->str[--s->len] = '\0';
+	if (s->len > 0 && str[s->len - 1] == '\n') {
+		str[--s->len] = '\0';
 		n++;
 	}
-	if (s->len > 0 && s->str[s->len - 1] == '\r') {
-		s->str[--s->len] = '\0';
+	if (s->len > 0 && str[s->len - 1] == '\r') {
+		str[--s->len] = '\0';
 		n++;
 	}
 	return n;
@@ -177,8 +276,7 @@ int dstring_concat(struct dstring *s, char const *str, long len)
 		return err;
 	}
 
-	assert(s->str);
-	memcpy(s->str + end, str, len);
+	memcpy(DSTRING_DATA(s) + end, str, len);
 	return 0;
 }
 
@@ -226,6 +324,31 @@ int dstring_printf(struct dstring *s, char const *fmt, ...)
 	return err;
 }
 
+/*! dstring_concat_i64 appends the decimal representation of `x`.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int dstring_concat_i64(struct dstring *s, int64_t x);
+
+/*! dstring_concat_u64 appends the decimal representation of `x`.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int dstring_concat_u64(struct dstring *s, uint64_t x);
+
+/*! dstring_concat_hex appends the lowercase hexadecimal representation of
+ * `x`, without prefix nor leading zeros.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int dstring_concat_hex(struct dstring *s, uint64_t x);
+
+/*! dstring_concat_double appends the shortest representation of `x` that
+ * reads back to `x` with `strtod`: decimal point notation when `x` has
+ * few enough digits (`-0`, `3`, `0.1`, `1234.5678`), `%g` style exponent
+ * notation otherwise, `nan`, `inf` or `-inf`. Subnormal numbers may
+ * get more digits than needed.
+ * It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int dstring_concat_double(struct dstring *s, double x);
+
 /*! dstring_setstr copy len characters from `str` to `s`.
  * It returns `0` on success or `-ENOMEM` on out of memory.
  */
@@ -241,7 +364,7 @@ int dstring_setstr(struct dstring *s, char const *str, long len)
 		return err;
 	}
 
-	memmove(s->str, str, len);
+	memmove(DSTRING_DATA(s), str, len);
 	return 0;
 }
 
@@ -253,7 +376,7 @@ char const *dstring_str(struct dstring const *s)
 {
 	assert(s);
 
-	return s->cap > 0 ? s->str : "";
+	return DSTRING_DATA(s);
 }
 
 #if DSTRING_NEGATIVE_INDEX
@@ -272,7 +395,7 @@ char *dstring_at(struct dstring const *s, long i)
 
 	i = DSTRING_INDEX(s, i);
 
-	return i < s->len ? s->str + i : NULL;
+	return i < s->len ? DSTRING_DATA(s) + i : NULL;
 }
 
 /*! dstring_len returns the number of characters. */
@@ -291,7 +414,7 @@ long dstring_len(struct dstring const *s)
 inline
 int dstring_compare(struct dstring const *s1, struct dstring const *s2)
 {
-	int n = memcmp(s1->str, s2->str,
+	int n = memcmp(DSTRING_DATA(s1), DSTRING_DATA(s2),
 			s1->len < s2->len ?
 			s1->len : s2->len);
 	if (n != 0) {
@@ -300,6 +423,134 @@ int dstring_compare(struct dstring const *s1, struct dstring const *s2)
 	return s1->len - s2->len;
 }
 
+/*! dstring_fnv1a returns the FNV1a hash code of the `len` characters of
+ * `s`, without scanning for the terminating null byte like `fnv1a_str`.
+ */
+unsigned long dstring_fnv1a(struct dstring const *s);
+
+/*! dstring_hash returns the `wyhash_mem` hash code of the dynamic string
+ * pointed to by `s`. Its signature allows to use it directly as
+ * `htable_interface::hash` when the keys are `struct dstring`.
+ */
+unsigned long dstring_hash(void const *s, unsigned long seed);
+
+/*! Non-owning view of `len` characters at `p`, not null terminated.
+ * A view of a dynamic string is valid until the string is modified, or
+ * moved when it is short enough to be inline.
+ */
+struct dstring_view {
+	char const *p;
+	long len;
+};
+
+/*! dstring_view returns a view of all the characters of `s`. */
+inline
+struct dstring_view dstring_view(struct dstring const *s)
+{
+	assert(s);
+
+	struct dstring_view v = { DSTRING_DATA(s), s->len };
+	return v;
+}
+
+/*! dstring_view_compare compares views like `dstring_compare`. */
+inline
+int dstring_view_compare(struct dstring_view v1, struct dstring_view v2)
+{
+	int n = memcmp(v1.p, v2.p, v1.len < v2.len ? v1.len : v2.len);
+	if (n != 0) {
+		return n;
+	}
+	return (v1.len > v2.len) - (v1.len < v2.len);
+}
+
+/*! dstring_find returns a view of the first occurrence of the `len`
+ * characters at `str` in `v`, or a view `{NULL, 0}` if there is none.
+ * Candidates are found with `memchr` on the first character.
+ */
+inline
+struct dstring_view dstring_find(struct dstring_view v, char const *str,
+		long len)
+{
+	assert(str || len == 0);
+	assert(len >= 0);
+
+	struct dstring_view r = { NULL, 0 };
+	if (len == 0) {
+		r.p = v.p;
+		return r;
+	}
+
+	long i = 0;
+	while (i <= v.len - len) {
+		char const *const p = (char const *)memchr(v.p + i, str[0],
+				v.len - len - i + 1);
+		if (!p) {
+			break;
+		} else if (memcmp(p + 1, str + 1, len - 1) == 0) {
+			r.p = p;
+			r.len = len;
+			break;
+		}
+		i = p - v.p + 1;
+	}
+	return r;
+}
+
+/*! dstring_next_token splits the first field delimited by `delim` off
+ * `rest` into `token`. Empty fields are kept, a trailing delimiter gives
+ * a last empty field. Once the last field is returned, `rest->p` is
+ * `NULL`. It returns `1` if a token was produced or `0` at the end.
+ *
+ *	struct dstring_view rest = dstring_view(&line), field;
+ *	while (dstring_next_token(&rest, ',', &field)) {
+ *		...
+ *	}
+ */
+inline
+int dstring_next_token(struct dstring_view *rest, char delim,
+		struct dstring_view *token)
+{
+	assert(rest);
+	assert(token);
+
+	if (!rest->p) {
+		return 0;
+	}
+
+	char const *const d = (char const *)memchr(rest->p, delim, rest->len);
+	token->p = rest->p;
+	if (d) {
+		token->len = d - rest->p;
+		rest->len -= token->len + 1;
+		rest->p = d + 1;
+	} else {
+		token->len = rest->len;
+		rest->p = NULL;
+		rest->len = 0;
+	}
+	return 1;
+}
+
+/*! dstring_split stores the fields of `v` delimited by `delim` to the `max`
+ * views of `fields`, the last one holding the rest of `v` if there are more.
+ * It returns the number of stored fields.
+ */
+long dstring_split(struct dstring_view v, char delim,
+		struct dstring_view *fields, long max);
+
+/*! dstring_view_hash returns the `wyhash_mem` hash code of the view pointed
+ * to by `v`, it is the `dstring_hash` of the same characters.
+ * With dstring_view_comp, it can be used as `htable_interface` when the
+ * entries begin with a `struct dstring_view` key.
+ */
+unsigned long dstring_view_hash(void const *v, unsigned long seed);
+
+/*! dstring_view_comp returns 0 if the views pointed to by `key` and
+ * `entry` hold the same characters.
+ */
+int dstring_view_comp(void const *key, void const *entry);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "bench.h"
+#include "dstring.h"
+
+/* Rows: dstring,<variant>,<final length>,<op>,<ns per call>,ns */
+
+#define LEN	(1L << 22)
+
+static void bench_concat(long chunk)
+{
+	static char const src[64] = "0123456789abcdef0123456789abcdef"
+		"0123456789abcdef0123456789abcde";
+	char variant[32];
+	double best = 1e300;
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		struct dstring s;
+		dstring_create(&s);
+		long i;
+		double const t = bench_now();
+		for (i = 0; i < LEN / chunk; i++) {
+			dstring_concat(&s, src, chunk);
+		}
+		double const dt = (bench_now() - t) / (LEN / chunk);
+		best = dt < best ? dt : best;
+		dstring_destroy(&s);
+	}
+	snprintf(variant, sizeof(variant), "chunk%ld", chunk);
+	bench_row("dstring", variant, LEN, "concat", best, "ns");
+}
+
+static void bench_concatf(void)
+{
+	double best = 1e300;
+	long len = 0;
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		struct dstring s;
+		dstring_create(&s);
+		long i;
+		double const t = bench_now();
+		for (i = 0; i < LEN / 8; i++) {
+			dstring_concatf(&s, "%ld,", i);
+		}
+		double const dt = (bench_now() - t) / (LEN / 8);
+		best = dt < best ? dt : best;
+		len = s.len;
+		dstring_destroy(&s);
+	}
+	bench_row("dstring", "int", len, "concatf", best, "ns");
+}
+
+static void bench_i64(void)
+{
+	double best = 1e300;
+	long len = 0;
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		struct dstring s;
+		dstring_create(&s);
+		long i;
+		double const t = bench_now();
+		for (i = 0; i < LEN / 8; i++) {
+			dstring_concat_i64(&s, i);
+			dstring_concat(&s, ",", 1);
+		}
+		double const dt = (bench_now() - t) / (LEN / 8);
+		best = dt < best ? dt : best;
+		len = s.len;
+		dstring_destroy(&s);
+	}
+	bench_row("dstring", "int", len, "concat_i64", best, "ns");
+}
+
+static void bench_double(int printf_style)
+{
+	double best = 1e300;
+	long len = 0;
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		struct dstring s;
+		dstring_create(&s);
+		long i;
+		double const t = bench_now();
+		for (i = 0; i < LEN / 16; i++) {
+			/* prices and measures, a few decimals */
+			double const x = (double)(i % 100000) / 100;
+			if (printf_style) {
+				dstring_concatf(&s, "%.17g,", x);
+			} else {
+				dstring_concat_double(&s, x);
+				dstring_concat(&s, ",", 1);
+			}
+		}
+		double const dt = (bench_now() - t) / (LEN / 16);
+		best = dt < best ? dt : best;
+		len = s.len;
+		dstring_destroy(&s);
+	}
+	bench_row("dstring", "cents", len,
+			printf_style ? "concatf" : "concat_double", best, "ns");
+}
+
+/* fields of CSV lines, copied to dstrings or as views */
+static void bench_fields(int copy)
+{
+	static char const line[] =
+		"2024-05-01T12:00:00,GET,/index.html,200,5120,0.013";
+	struct dstring_view const v = { line, sizeof(line) - 1 };
+	struct dstring fields[6];
+	double best = 1e300;
+	long sum = 0;
+	int r, j;
+	for (j = 0; j < 6; j++) {
+		dstring_create(&fields[j]);
+	}
+	for (r = 0; r < BENCH_RUNS; r++) {
+		long i;
+		double const t = bench_now();
+		for (i = 0; i < LEN / 64; i++) {
+			struct dstring_view rest = v, field;
+			j = 0;
+			while (dstring_next_token(&rest, ',', &field)) {
+				if (copy) {
+					/* fresh strings, as when kept per line */
+					dstring_destroy(&fields[j]);
+					dstring_setstr(&fields[j], field.p, field.len);
+					sum += fields[j].len;
+				} else {
+					sum += field.len;
+				}
+				j++;
+			}
+		}
+		double const dt = (bench_now() - t) / (LEN / 64);
+		best = dt < best ? dt : best;
+	}
+	for (j = 0; j < 6; j++) {
+		dstring_destroy(&fields[j]);
+	}
+	bench_row("dstring", copy ? "setstr" : "view", sum > 0 ? v.len : 0,
+			"fields", best, "ns");
+}
+
+/* fresh short strings, e.g. ids or header names */
+static void bench_short(long len)
+{
+	static char const src[64] = "0123456789abcdef0123456789abcdef"
+		"0123456789abcdef0123456789abcde";
+	char variant[32];
+	double best = 1e300;
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		long i;
+		double const t = bench_now();
+		for (i = 0; i < LEN / 8; i++) {
+			struct dstring s;
+			dstring_create(&s);
+			dstring_setstr(&s, src + (i & 7), len);
+			dstring_destroy(&s);
+		}
+		double const dt = (bench_now() - t) / (LEN / 8);
+		best = dt < best ? dt : best;
+	}
+	snprintf(variant, sizeof(variant), "len%ld", len);
+	bench_row("dstring", variant, len, "setstr", best, "ns");
+}
+
+int main(void)
+{
+	bench_concat(1);
+	bench_concat(8);
+	bench_concat(64);
+	bench_concatf();
+	bench_i64();
+	bench_double(1);
+	bench_double(0);
+	bench_fields(1);
+	bench_fields(0);
+	bench_short(8);
+	bench_short(23);
+	bench_short(48);
+	return 0;
+}
@@ -0,0 +1,271 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "dstring_io.h"
+
+#if defined(IOV_MAX) && IOV_MAX < DSTRING_WRITER_IOV
+#	error DSTRING_WRITER_IOV greater than IOV_MAX.
+#endif
+
+void dstring_reader_create(struct dstring_reader *r, int fd, long block)
+{
+	assert(r);
+
+	dstring_create(&r->buf);
+	r->map = NULL;
+	r->size = 0;
+	r->pos = 0;
+	r->scan = 0;
+	r->block = block > 0 ? block : DSTRING_IO_BLOCK;
+	r->fd = fd;
+	r->eof = 0;
+}
+
+void dstring_reader_destroy(struct dstring_reader *r)
+{
+	assert(r);
+
+	if (r->map) {
+		munmap((void *)r->map, r->size);
+		r->map = NULL;
+	}
+	dstring_destroy(&r->buf);
+	r->size = 0;
+	r->pos = 0;
+	r->scan = 0;
+	r->eof = 0;
+}
+
+int dstring_reader_map(struct dstring_reader *r)
+{
+	assert(r);
+	assert(!r->map && r->buf.len == 0 && !r->eof);
+
+	struct stat st;
+	if (fstat(r->fd, &st)) {
+		return -errno;
+	} else if (!S_ISREG(st.st_mode)) {
+		return -ENODEV;
+	}
+	off_t const off = lseek(r->fd, 0, SEEK_CUR);
+	if (off < 0) {
+		return -errno;
+	}
+
+	if (st.st_size > off) {
+		/* from 0, the offset of mmap must be page aligned */
+		void *const p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+				r->fd, 0);
+		if (p == MAP_FAILED) {
+			return -errno;
+		}
+		posix_madvise(p, st.st_size, POSIX_MADV_SEQUENTIAL);
+		r->map = (char const *)p;
+		r->size = st.st_size;
+		r->pos = off;
+		r->scan = off;
+	}
+	r->eof = 1;
+	lseek(r->fd, 0, SEEK_END);
+	return 0;
+}
+
+/* Drops the lines read and reads a block after the partial line left. */
+static
+int dr_fill(struct dstring_reader *r)
+{
+	long const keep = r->buf.len - r->pos;
+	if (r->pos > 0) {
+		char *const data = DSTRING_DATA(&r->buf);
+		memmove(data, data + r->pos, keep);
+		r->scan -= r->pos;
+		r->pos = 0;
+	}
+
+	/* lines longer than a block grow the buffer */
+	int const err = dstring_setlen(&r->buf, keep + r->block);
+	if (err) {
+		dstring_setlen(&r->buf, keep);
+		return err;
+	}
+	ssize_t n;
+	do {
+		n = read(r->fd, DSTRING_DATA(&r->buf) + keep, r->block);
+	} while (n < 0 && errno == EINTR);
+	dstring_setlen(&r->buf, n > 0 ? keep + n : keep);
+	if (n < 0) {
+		return -errno;
+	} else if (n == 0) {
+		r->eof = 1;
+	}
+	return 0;
+}
+
+int dstring_reader_getline(struct dstring_reader *r, struct dstring_view *line)
+{
+	assert(r);
+	assert(line);
+
+	for (;;) {
+		char const *const data = r->map ? r->map : DSTRING_DATA(&r->buf);
+		long const len = r->map ? r->size : r->buf.len;
+		char const *const lf = (char const *)memchr(data + r->scan, '\n',
+				len - r->scan);
+		long end;
+		if (lf) {
+			end = lf - data;
+			r->scan = end + 1;
+		} else if (!r->eof) {
+			r->scan = len;
+			int const err = dr_fill(r);
+			if (err) {
+				return err;
+			}
+			continue;
+		} else if (r->pos < len) {
+			end = len;
+			r->scan = len;
+		} else {
+			return 0;
+		}
+
+		line->p = data + r->pos;
+		line->len = end - r->pos;
+		if (line->len > 0 && line->p[line->len - 1] == '\r') {
+			line->len--;
+		}
+		r->pos = r->scan;
+		return 1;
+	}
+}
+
+void dstring_writer_create(struct dstring_writer *w, int fd, long block)
+{
+	assert(w);
+
+	dstring_create(&w->buf);
+	w->niov = 0;
+	w->fd = fd;
+	w->pending = 0;
+	w->block = block > 0 ? block : DSTRING_IO_BLOCK;
+}
+
+int dstring_writer_destroy(struct dstring_writer *w)
+{
+	assert(w);
+
+	int const err = dstring_writer_flush(w);
+	dstring_destroy(&w->buf);
+	return err;
+}
+
+int dstring_writer_write(struct dstring_writer *w, char const *p, long len)
+{
+	assert(w);
+	assert(p || len == 0);
+	assert(len >= 0);
+
+	if (len == 0) {
+		return 0;
+	} else if (w->niov == DSTRING_WRITER_IOV) {
+		int const err = dstring_writer_flush(w);
+		if (err) {
+			return err;
+		}
+	}
+
+	if (len < DSTRING_WRITER_COPY) {
+		long const off = w->buf.len;
+		if (dstring_concat(&w->buf, p, len)) {
+			return -ENOMEM;
+		}
+		if (w->niov > 0 && !w->iov[w->niov - 1].p) {
+			/* the last piece ends the buffer, extend it */
+			w->iov[w->niov - 1].len += len;
+		} else {
+			w->iov[w->niov].p = NULL;
+			w->iov[w->niov].off = off;
+			w->iov[w->niov].len = len;
+			w->niov++;
+		}
+	} else {
+		w->iov[w->niov].p = p;
+		w->iov[w->niov].off = 0;
+		w->iov[w->niov].len = len;
+		w->niov++;
+	}
+
+	w->pending += len;
+	return w->pending >= w->block ? dstring_writer_flush(w) : 0;
+}
+
+int dstring_writer_flush(struct dstring_writer *w)
+{
+	assert(w);
+
+	struct iovec v[DSTRING_WRITER_IOV];
+	int const niov = w->niov;
+	int i;
+	for (i = 0; i < niov; i++) {
+		v[i].iov_base = w->iov[i].p ? (void *)w->iov[i].p :
+			DSTRING_DATA(&w->buf) + w->iov[i].off;
+		v[i].iov_len = w->iov[i].len;
+	}
+
+	int err = 0;
+	i = 0;
+	while (i < niov) {
+		ssize_t n = writev(w->fd, v + i, niov - i);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n <= 0) {
+			err = n < 0 ? -errno : -EIO;
+			break;
+		}
+		/* skip what was written, partially for the last piece */
+		while (i < niov && (size_t)n >= v[i].iov_len) {
+			n -= v[i].iov_len;
+			i++;
+		}
+		if (i < niov) {
+			v[i].iov_base = (char *)v[i].iov_base + n;
+			v[i].iov_len -= n;
+		}
+	}
+
+	w->niov = 0;
+	w->pending = 0;
+	dstring_setlen(&w->buf, 0);
+	return err;
+}
@@ -0,0 +1,136 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CDS_DSTRING_IO_H
+#define CDS_DSTRING_IO_H
+
+/*!
+ * \file dstring_io.h
+ * \author Jonathan Debove
+ * \brief Block line reader and gathering writer on file descriptors.
+ */
+
+#include "dstring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Default size of the blocks read or written at once. */
+#define DSTRING_IO_BLOCK	(1L << 20)
+
+/*! Number of pieces gathered by a writer, at most `IOV_MAX`. */
+#define DSTRING_WRITER_IOV	64
+
+/*! Pieces of at least this size are not copied by a writer. */
+#define DSTRING_WRITER_COPY	512
+
+/*! Line reader of a file descriptor.
+ * The file is read by blocks into a single dynamic string, or mapped.
+ */
+struct dstring_reader {
+	/* private */
+	struct dstring buf;
+	char const *map;	/* mapped file or NULL	*/
+	long size;		/* mapped size		*/
+	long pos;		/* start of next line	*/
+	long scan;		/* no LF before there	*/
+	long block;
+	int fd;
+	int eof;
+};
+
+/*! dstring_reader_create initializes a reader of `fd` by blocks of `block`
+ * bytes, `DSTRING_IO_BLOCK` if `block <= 0`.
+ * It cannot fail and does not allocate memory. `fd` is not closed by
+ * dstring_reader_destroy.
+ */
+void dstring_reader_create(struct dstring_reader *r, int fd, long block);
+
+/*! dstring_reader_destroy frees the buffer, or unmaps the file. */
+void dstring_reader_destroy(struct dstring_reader *r);
+
+/*! dstring_reader_map maps the file of a new reader instead of reading it,
+ * from its current offset to its end.
+ * It returns `0` on success or a negative `errno` value, e.g. `-ENODEV`
+ * if `fd` cannot be mapped (pipe, socket...); the reader reads blocks then.
+ */
+int dstring_reader_map(struct dstring_reader *r);
+
+/*! dstring_reader_getline sets `line` to a view of the next line, without
+ * the trailing LF and CR like `dstring_chomp`. A last line without LF is
+ * returned. The view is valid until the next call.
+ * It returns `1` on success, `0` at the end of the file or a negative
+ * `errno` value on error, e.g. `-ENOMEM`.
+ */
+int dstring_reader_getline(struct dstring_reader *r, struct dstring_view *line);
+
+/*! Gathering writer of a file descriptor.
+ * Small pieces are copied to a buffer, large ones referenced, and all are
+ * written at once with `writev`.
+ */
+struct dstring_writer {
+	/* private */
+	struct dstring buf;
+	struct {
+		char const *p;	/* NULL for buf	*/
+		long off;
+		long len;
+	} iov[DSTRING_WRITER_IOV];
+	int niov;
+	int fd;
+	long pending;
+	long block;
+};
+
+/*! dstring_writer_create initializes a writer to `fd` flushing every
+ * `block` bytes, `DSTRING_IO_BLOCK` if `block <= 0`.
+ * It cannot fail and does not allocate memory. `fd` is not closed by
+ * dstring_writer_destroy.
+ */
+void dstring_writer_create(struct dstring_writer *w, int fd, long block);
+
+/*! dstring_writer_destroy flushes and frees the buffer.
+ * It returns the result of dstring_writer_flush.
+ */
+int dstring_writer_destroy(struct dstring_writer *w);
+
+/*! dstring_writer_write appends `len` bytes from `p`.
+ * Pieces of `DSTRING_WRITER_COPY` bytes or more are not copied: they must
+ * stay valid until the next flush, explicit or not.
+ * It returns `0` on success or a negative `errno` value.
+ */
+int dstring_writer_write(struct dstring_writer *w, char const *p, long len);
+
+/*! dstring_writer_flush writes all the pending bytes.
+ * It returns `0` on success or a negative `errno` value, the pending bytes
+ * being dropped.
+ */
+int dstring_writer_flush(struct dstring_writer *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDS_DSTRING_IO_H */
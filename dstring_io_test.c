@@ -0,0 +1,69 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dstring_io.h"
+
+static void read_lines(int fd, int map)
+{
+	struct dstring_reader r;
+	struct dstring_view line;
+	long n = 0, bytes = 0;
+	int err;
+
+	lseek(fd, 0, SEEK_SET);
+	dstring_reader_create(&r, fd, 64);			/* Small blocks */
+	if (map && dstring_reader_map(&r)) {			/* Or mapped */
+		printf("cannot map\n");
+	}
+	while ((err = dstring_reader_getline(&r, &line)) > 0) {
+		if (n < 2) {
+			int const k = line.len < 8 ? line.len : 8;
+			printf("%.*s (%ld)\n", k, line.p, line.len);
+		}
+		n++;
+		bytes += line.len;
+	}
+	printf("%s: %ld lines, %ld bytes, err=%d\n", map ? "map" : "read",
+			n, bytes, err);
+	dstring_reader_destroy(&r);
+}
+
+int main(void)
+{
+	char path[] = "/tmp/dstring_io_testXXXXXX";
+	int const fd = mkstemp(path);
+	if (fd < 0) {
+		return 1;
+	}
+	unlink(path);
+
+	struct dstring_writer w;
+	struct dstring s;
+	long i;
+	dstring_writer_create(&w, fd, 0);
+	dstring_create(&s);
+	for (i = 0; i < 200; i++) {				/* Long line */
+		dstring_concat(&s, "0123456789", 10);
+	}
+	for (i = 0; i < 1000; i++) {
+		char num[32];
+		int const n = snprintf(num, sizeof(num), "line %ld\r\n", i);
+		dstring_writer_write(&w, num, n);		/* Copied */
+		if (i % 100 == 0) {
+			dstring_writer_write(&w, dstring_str(&s), s.len);
+			dstring_writer_write(&w, "\n", 1);
+		}
+	}
+	dstring_writer_write(&w, "no end of line", 14);
+	dstring_writer_destroy(&w);				/* Flush */
+	dstring_destroy(&s);
+
+	read_lines(fd, 0);
+	read_lines(fd, 1);
+
+	close(fd);
+	return 0;
+}
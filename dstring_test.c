@@ -23,6 +23,24 @@ int main(void)
 	print(&s);
 	dstring_setcap(&s, s.len + 1);
 	print(&s);
+	dstring_concat(&s, " spills to the heap", 19);	/* Long string */
+	print(&s);
+	dstring_reserve(&s, 64);				/* One check */
+	dstring_concat(&s, " ", 1);
+	dstring_concat_i64(&s, -42);
+	dstring_concat(&s, " 0x", 3);
+	dstring_concat_hex(&s, 0xbeef);
+	dstring_concat(&s, " ", 1);
+	dstring_concat_double(&s, 0.1);
+	print(&s);
+	printf("fnv1a=%lx, wyhash=%lx\n", dstring_fnv1a(&s),
+			dstring_hash(&s, 0));		/* Hash */
+
+	struct dstring_view rest = dstring_view(&s), field;	/* Views */
+	while (dstring_next_token(&rest, ' ', &field)) {
+		printf("[%.*s]", (int)field.len, field.p);
+	}
+	printf("\n");
 
 	dstring_destroy(&s);					/* Reset */
 
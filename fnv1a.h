@@ -51,11 +51,26 @@ extern "C" {
 /* Stupid macro to help doxygen */
 #define STATIC static
 
-/*! fnv1a_mem computes the FNV1a hash code of a memory area. */
+/*!
+ * fnv1a_init returns the initial state of an incremental FNV1a hash.
+ * Fragments are hashed with fnv1a_update and the hash code is returned by
+ * fnv1a_final, it is the fnv1a_mem of their concatenation:
+ *
+ *	unsigned long h = fnv1a_init();
+ *	h = fnv1a_update(h, prefix, prefix_len);
+ *	h = fnv1a_update(h, &id, sizeof(id));
+ *	h = fnv1a_final(h);
+ */
 STATIC inline
-unsigned long fnv1a_mem(void const *s, size_t len)
+unsigned long fnv1a_init(void)
+{
+	return FNV1A_BASE;
+}
+
+/*! fnv1a_update hashes `len` bytes from `s` into the state `h`. */
+STATIC inline
+unsigned long fnv1a_update(unsigned long h, void const *s, size_t len)
 {
-	unsigned long h = FNV1A_BASE;
 	unsigned char const *b = (unsigned char const *)s;
 	while (len--) {
 		int c = *b++;
@@ -64,6 +79,20 @@ unsigned long fnv1a_mem(void const *s, size_t len)
 	return h;
 }
 
+/*! fnv1a_final returns the hash code of the state `h`. */
+STATIC inline
+unsigned long fnv1a_final(unsigned long h)
+{
+	return h;
+}
+
+/*! fnv1a_mem computes the FNV1a hash code of a memory area. */
+STATIC inline
+unsigned long fnv1a_mem(void const *s, size_t len)
+{
+	return fnv1a_update(FNV1A_BASE, s, len);
+}
+
 /*! fnv1a_str computes the FNV1a hash code of a string. */
 STATIC inline
 unsigned long fnv1a_str(char const *s)
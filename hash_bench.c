@@ -0,0 +1,80 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+
+#include "bench.h"
+#include "fnv1a.h"
+#include "wyhash.h"
+
+/* Rows: hash,<function>,<key bytes>,<op>,<value>,GB/s or ns */
+
+#define LEN	(1L << 20)
+
+static volatile unsigned long sink;
+
+static void bench_mem(char const *name,
+		unsigned long (*fn)(void const *, size_t),
+		unsigned char const *buf, long len)
+{
+	long const n = (1L << 26) / len;
+	double best = 1e300;
+	int r;
+	for (r = 0; r < BENCH_RUNS; r++) {
+		unsigned long h = 0;
+		long i;
+		double t = bench_now();
+		for (i = 0; i < n; i++) {
+			h += fn(buf + (i & 63), len);
+		}
+		t = bench_now() - t;
+		sink = h;
+		best = t < best ? t : best;
+	}
+	if (len >= 1024) {
+		bench_row("hash", name, len, "mem", len * n / best, "GB/s");
+	} else {
+		bench_row("hash", name, len, "mem", best / n, "ns");
+	}
+}
+
+static unsigned long fnv1a(void const *s, size_t len)
+{
+	return fnv1a_mem(s, len);
+}
+
+static unsigned long wyhash(void const *s, size_t len)
+{
+	return wyhash_mem(s, len, 0x9e3779b97f4a7c15);
+}
+
+/* composite key hashed in place in three fragments */
+static unsigned long wyhash3(void const *s, size_t len)
+{
+	unsigned char const *p = (unsigned char const *)s;
+	struct wyhash w;
+	wyhash_init(&w, 0x9e3779b97f4a7c15);
+	wyhash_update(&w, p, len / 4);
+	wyhash_update(&w, p + len / 4, len / 4);
+	wyhash_update(&w, p + len / 2, len - len / 2);
+	return wyhash_final(&w);
+}
+
+int main(void)
+{
+	static long const lens[] = { 8, 16, 64, 256, 512, LEN };
+	unsigned char *const buf = malloc(LEN + 64);
+	uint64_t seed = 1;
+	long i;
+	for (i = 0; i < LEN + 64; i++) {
+		buf[i] = (unsigned char)bench_rand(&seed);
+	}
+
+	for (i = 0; i < (long)(sizeof(lens) / sizeof(lens[0])); i++) {
+		bench_mem("fnv1a", fnv1a, buf, lens[i]);
+		bench_mem("wyhash", wyhash, buf, lens[i]);
+		bench_mem("wyhash-3parts", wyhash3, buf, lens[i]);
+	}
+
+	free(buf);
+	return 0;
+}
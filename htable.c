@@ -22,14 +22,30 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "darray.h"
 #include "htable.h"
 
+#ifdef HTABLE_USE_SIMD
+#	if defined(__SSE2__)
+#		include <emmintrin.h>
+#	elif defined(__ARM_NEON)
+#		include <arm_neon.h>
+#	endif
+#endif
+
 enum hbucket_state {
 	HBUCKET_EMPTY = 0,
 	HBUCKET_TOMB  = 1,
@@ -40,15 +56,9 @@ struct hbucket {
 	unsigned long hash;
 };
 
-#if ULONG_MAX == 0xffffffff
-#	define HTABLE_BITS 32
-#	define HTABLE_MULT 0x93c467e3U
-#elif ULONG_MAX == 0xffffffffffffffff
-#	define HTABLE_BITS 64
-#	define HTABLE_MULT 0x93c467e37db0c7a3U
-#else
-#	error ULONG_WIDTH different from 32 and 64 not implemented.
-#endif
+struct hbucket32 {
+	uint32_t hash;
+};
 
 #define HTABLE_PROBE_LOOP(idx, hash, htab, body) do {			\
 	long ht__i;							\
@@ -58,9 +68,193 @@ struct hbucket {
 	{ body }							\
 } while (0)
 
-#define HTABLE_SHIFT_MIN	3
-#define HTABLE_SIZE(shift)	(1L << (shift))
-#define HTABLE_CAP(shift)	((1L << ((shift) - 2)) * 3)
+#if defined(HTABLE_USE_SIMD) && defined(HTABLE_USE_ROBINHOOD)
+#	error HTABLE_USE_SIMD and HTABLE_USE_ROBINHOOD are exclusive.
+#endif
+
+#if defined(HTABLE_USE_SIMD)
+#	define HTABLE_MODE	HTABLE_MODE_SIMD
+#elif defined(HTABLE_USE_ROBINHOOD)
+#	define HTABLE_MODE	HTABLE_MODE_ROBINHOOD
+#else
+#	define HTABLE_MODE	HTABLE_MODE_DEFAULT
+#endif
+
+#ifdef HTABLE_USE_SIMD
+#	define HTABLE_SHIFT_MIN	4
+#	define HTABLE_CTRL_SIZE	1
+#else
+#	define HTABLE_SHIFT_MIN	3
+#	define HTABLE_CTRL_SIZE	0
+#endif
+
+/* Robin Hood deletion shifts entries back over the deleted one:
+ * an extra entry keeps a copy of it for htable_delete.
+ */
+#ifdef HTABLE_USE_ROBINHOOD
+#	define HTABLE_SPARE	1
+#else
+#	define HTABLE_SPARE	0
+#endif
+#define HTABLE_SIZE(shift)	((long)(1UL << (shift)))
+
+/* Flag (htable.c only) to count the lookups and `comp` calls into the
+ * counters set by htable_setstats:
+ * #define HTABLE_USE_STATS
+ */
+#ifdef HTABLE_USE_STATS
+#	include <time.h>
+/* Counters are updated atomically: lookups may run concurrently, e.g.
+ * under the read lock of htable_sharded.
+ */
+#	ifndef __GNUC__
+#		error "HTABLE_USE_STATS needs the __atomic builtins"
+#	endif
+#	define HTABLE_ADD(p, n)	__atomic_fetch_add((p), (n), __ATOMIC_RELAXED)
+#	define HTABLE_COUNT(ht, field)	do {				\
+		if ((ht)->stats) {					\
+			HTABLE_ADD(&(ht)->stats->field, 1);		\
+		}							\
+	} while (0)
+#else
+#	define HTABLE_COUNT(ht, field)	((void)0)
+#endif
+
+/* Private layout flag of a table image mapped by htable_map. */
+#define HTABLE_MAPPED		0x100
+
+/* Number of keys hashed and prefetched ahead by the batched functions. */
+#define HTABLE_BATCH		16
+
+/* log2 of the maximum number of partitions of htable_build. */
+#define HTABLE_BUILD_BITS	10
+
+#if defined(__GNUC__)
+#	define HTABLE_PREFETCH(addr)	__builtin_prefetch(addr)
+#else
+#	define HTABLE_PREFETCH(addr)	((void)(addr))
+#endif
+
+#ifdef HTABLE_USE_SIMD
+
+/* Control byte of a bucket: 0xxxxxxx holds 7 bits of the hash of
+ * a used bucket, the high bit is set for empty and tomb buckets.
+ */
+enum hctrl_state {
+	HCTRL_EMPTY = 0x80,
+	HCTRL_TOMB  = 0xfe,
+};
+
+#define HGROUP_SIZE	16
+
+/* Same triangular probing as HTABLE_PROBE_LOOP but over aligned groups. */
+#define HGROUP_LOOP(pos, hash, htab, body) do {				\
+	long ht__i;							\
+	for (ht__i = 0, (pos) = (((hash) * HTABLE_MULT) >>		\
+			(HTABLE_BITS - (htab)->shift)) &		\
+			~(long)(HGROUP_SIZE - 1);;			\
+		ht__i += HGROUP_SIZE,					\
+		(pos) = ((pos) + ht__i) & (htab)->mask)			\
+	{ body }							\
+} while (0)
+
+/* Bit mask with HGROUP_STRIDE bits per bucket of a group. */
+typedef unsigned long long hgroup_mask;
+
+#if defined(__SSE2__)
+#	define HGROUP_STRIDE 1
+#	define HGROUP_ALL 0xffffULL
+
+static inline
+hgroup_mask hgroup_match(unsigned char const *ctrl, unsigned char c)
+{
+	__m128i const v = _mm_loadu_si128((__m128i const *)ctrl);
+	return (unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8((char)c)));
+}
+
+static inline
+hgroup_mask hgroup_free(unsigned char const *ctrl)
+{
+	__m128i const v = _mm_loadu_si128((__m128i const *)ctrl);
+	return (unsigned)_mm_movemask_epi8(v);
+}
+
+#elif defined(__ARM_NEON)
+#	define HGROUP_STRIDE 4
+#	define HGROUP_ALL 0x8888888888888888ULL
+
+static inline
+hgroup_mask hgroup_tomask(uint8x16_t v)
+{
+	uint8x8_t const n = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+	return vget_lane_u64(vreinterpret_u64_u8(n), 0) &
+		0x8888888888888888ULL;
+}
+
+static inline
+hgroup_mask hgroup_match(unsigned char const *ctrl, unsigned char c)
+{
+	return hgroup_tomask(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(c)));
+}
+
+static inline
+hgroup_mask hgroup_free(unsigned char const *ctrl)
+{
+	return hgroup_tomask(vtstq_u8(vld1q_u8(ctrl), vdupq_n_u8(0x80)));
+}
+
+#else
+#	define HGROUP_STRIDE 1
+#	define HGROUP_ALL 0xffffULL
+
+static inline
+hgroup_mask hgroup_match(unsigned char const *ctrl, unsigned char c)
+{
+	hgroup_mask m = 0;
+	int k;
+	for (k = 0; k < HGROUP_SIZE; k++) {
+		m |= (hgroup_mask)(ctrl[k] == c) << k;
+	}
+	return m;
+}
+
+static inline
+hgroup_mask hgroup_free(unsigned char const *ctrl)
+{
+	hgroup_mask m = 0;
+	int k;
+	for (k = 0; k < HGROUP_SIZE; k++) {
+		m |= (hgroup_mask)(ctrl[k] >> 7) << k;
+	}
+	return m;
+}
+
+#endif
+
+/* hgroup_first returns the index in the group of the first set bucket. */
+static inline
+int hgroup_first(hgroup_mask m)
+{
+	assert(m);
+#if defined(__GNUC__)
+	return __builtin_ctzll(m) / HGROUP_STRIDE;
+#else
+	int k;
+	for (k = 0; !(m & 1); k++, m >>= 1);
+	return k / HGROUP_STRIDE;
+#endif
+}
+
+/* ht_tagof takes the 7 bits following those used by the home bucket. */
+static
+unsigned char ht_tagof(struct htable const *ht, unsigned long hash)
+{
+	int const s = HTABLE_BITS - 7 - ht->shift;
+	return ((hash * HTABLE_MULT) >> (s > 0 ? s : 0)) & 0x7f;
+}
+
+#endif /* HTABLE_USE_SIMD */
 
 void htable_create(struct htable *ht, long inc, unsigned long seed,
 		struct htable_interface const *hasher)
@@ -73,242 +267,1382 @@ void htable_create(struct htable *ht, long inc, unsigned long seed,
 
 	ht->data = NULL;
 	ht->table = NULL;
+	ht->ctrl = NULL;
 
 	ht->inc = inc;
 	ht->len = 0;
 	ht->cap = 0;
+	ht->tomb = 0;
 
 	ht->mask = -1;
 	ht->shift = HTABLE_SHIFT_MIN;
 
 	ht->seed = seed;
 	ht->hasher = hasher;
+
+	ht->old = NULL;
+	ht->step = 0;
+	ht->pos = 0;
+
+	ht->layout = HTABLE_SPLIT;
+	ht->hstride = sizeof(struct hbucket);
+	ht->dstride = inc;
+
+	struct htable_policy const policy = HTABLE_POLICY_DEFAULT;
+	ht->policy = policy;
+	ht->alloc = NULL;
+	ht->mode = HTABLE_MODE;
+	ht->stats = NULL;
+}
+
+/* ht_align returns the alignment of an inline bucket which is also the
+ * offset of the entry after the hash: the largest power of 2 dividing
+ * `inc` (at most 16), or the size of the hash if larger.
+ */
+static
+long ht_align(int layout, long inc)
+{
+	long const hsize = layout & HTABLE_HASH32 ?
+		sizeof(struct hbucket32) : sizeof(struct hbucket);
+	long const align = (inc & -inc) < 16 ? (inc & -inc) : 16;
+	return align > hsize ? align : hsize;
+}
+
+static void ht_unmap(struct htable *ht);
+
+/* ht_bytes returns the bytes allocated for a table of `size` buckets. */
+static
+long ht_bytes(struct htable const *ht, long size)
+{
+	/* split: hashes then entries, inline: entries after their hash */
+	long const bytes = ht->layout & HTABLE_INLINE ?
+		(size + HTABLE_SPARE) * ht->hstride :
+		size * ht->hstride + (size + HTABLE_SPARE) * ht->inc;
+	return bytes + size * HTABLE_CTRL_SIZE;
 }
 
 void htable_destroy(struct htable *ht)
 {
 	assert(ht);
 
-	free(ht->table);
+	if (ht->old) {
+		htable_destroy(ht->old);
+		allocator_free(ht->alloc, ht->old, sizeof(*ht->old));
+		ht->old = NULL;
+	}
+
+	if (ht->layout & HTABLE_MAPPED) {
+		ht_unmap(ht);
+	} else if (ht->mask >= 0) {
+		allocator_free(ht->alloc, ht->table,
+				ht_bytes(ht, ht->mask + 1));
+	}
 	ht->table = NULL;
 	ht->data = NULL;
+	ht->ctrl = NULL;
 	ht->mask = -1;
 	ht->shift = HTABLE_SHIFT_MIN;
 	ht->len = 0;
 	ht->cap = 0;
+	ht->tomb = 0;
 }
 
-static
-int htable_rehash(struct htable *ht, int shift)
+/* ht_scale returns `load` / 256 of 2^shift without overflowing. */
+static inline
+long ht_scale(int shift, long load)
 {
-	assert(ht);
-	assert(shift >= 2 && shift <= HTABLE_BITS - 1);
-	assert(HTABLE_CAP(shift) >= ht->len);
-
-	long const inc = ht->inc;
 	long const size = HTABLE_SIZE(shift);
+	return (size >> 8) * load + (((size & 255) * load) >> 8);
+}
 
-	struct htable htnew;
-	htable_create(&htnew, inc, ht->seed, ht->hasher);
-
-	htnew.table = malloc(size * (sizeof(htnew.table[0]) + inc));
-	if (!htnew.table) {
-		return -ENOMEM;
-	}
-
-	htnew.data = (char *)htnew.table + size * sizeof(htnew.table[0]);
-	htnew.cap = HTABLE_CAP(shift);
-	htnew.mask = size - 1;
-	htnew.shift = shift;
+/* ht_capof returns the number of entries a table of size 2^shift holds. */
+static inline
+long ht_capof(struct htable const *ht, int shift)
+{
+	return ht_scale(shift, ht->policy.max_load);
+}
 
-	long j;
-	for (j = 0; j < size; j++) {
-		htnew.table[j].hash = HBUCKET_EMPTY;
-	}
+int htable_setalloc(struct htable *ht, struct allocator const *alloc)
+{
+	assert(ht);
 
-	for (j = 0; j <= ht->mask; j++) {
-		if (ht->table[j].hash >= HBUCKET_USED) {
-			long i;
-			HTABLE_PROBE_LOOP(i, ht->table[j].hash, &htnew,
-				if (htnew.table[i].hash == HBUCKET_EMPTY) {
-					htnew.table[i].hash = ht->table[j].hash;
-					memcpy(htnew.data + i * inc,
-							ht->data + j * inc,
-							inc);
-					break;
-				}
-			);
-		}
+	if (ht->len > 0) {
+		return -EBUSY;
 	}
-	htnew.len = ht->len;
-	htnew.cap -= ht->len;
-
 	htable_destroy(ht);
-	*ht = htnew;
+	ht->alloc = alloc;
 	return 0;
 }
 
-int htable_resize(struct htable *ht, long cap)
+int htable_setlayout(struct htable *ht, int layout)
 {
 	assert(ht);
-	assert(cap > 0);
-	assert(HTABLE_SHIFT_MIN >= 2);
+	assert((layout & ~(HTABLE_INLINE | HTABLE_HASH32 | HTABLE_MIX)) == 0);
 
-	if (ht->len <= cap) {
-		int shift = HTABLE_CAP(ht->shift) <= cap ?
-			ht->shift : HTABLE_SHIFT_MIN;
-		for (; HTABLE_CAP(shift) < cap; shift++);
-		return shift != ht->shift ?
-			htable_rehash(ht, shift) : 0;
+	if (ht->len > 0) {
+		return -EBUSY;
 	}
+	htable_destroy(ht);
 
-	return -ENOSPC;
+	long const inc = ht->inc;
+	ht->layout = layout;
+	if (layout & HTABLE_INLINE) {
+		long const align = ht_align(layout, inc);
+		ht->hstride = (align + inc + align - 1) / align * align;
+		ht->dstride = ht->hstride;
+	} else {
+		ht->hstride = layout & HTABLE_HASH32 ?
+			sizeof(struct hbucket32) : sizeof(struct hbucket);
+		ht->dstride = inc;
+	}
+	return 0;
 }
 
+/* ht_hashed turns a user hash into the hash stored in the buckets */
 static
-unsigned long ht_hashof(struct htable const *ht, void const *key)
+unsigned long ht_hashed(struct htable const *ht, unsigned long hash)
 {
-	unsigned long hash = ht->hasher->hash(key, ht->seed);
+	if (ht->layout & HTABLE_MIX) {
+		hash = htable_mix(hash);
+	}
+	if (ht->layout & HTABLE_HASH32) {
+		hash = (uint32_t)(hash ^ (hash >> 16 >> 16));
+	}
 	return hash >= HBUCKET_USED ? hash : HBUCKET_USED;
 }
 
+static
+unsigned long ht_hashof(struct htable const *ht, void const *key)
+{
+	return ht_hashed(ht, ht->hasher->hash(key, ht->seed));
+}
+
+/* Buckets are addressed with strides to support both layouts. */
+static inline
+unsigned long ht_hash(struct htable const *ht, long idx)
+{
+	char const *const b = ht->table + idx * ht->hstride;
+	return ht->layout & HTABLE_HASH32 ?
+		((struct hbucket32 const *)b)->hash :
+		((struct hbucket const *)b)->hash;
+}
+
+static inline
+char *ht_entry(struct htable const *ht, long idx)
+{
+	return ht->data + idx * ht->dstride;
+}
+
 static
 int ht_isequal(struct htable const *ht, long idx, unsigned long hash,
 		void const *key)
 {
-	return ht->table[idx].hash == hash &&
-		ht->hasher->comp(key, &ht->data[idx * ht->inc]) == 0;
+	if (ht_hash(ht, idx) != hash) {
+		return 0;
+	}
+	HTABLE_COUNT(ht, comps);
+	return ht->hasher->comp(key, ht_entry(ht, idx)) == 0;
 }
 
-void *htable_enter_unsafe(struct htable *ht, void const *key, int *err)
+/* ht_clock returns the time in ns when counting the time of rehashes. */
+static inline
+long ht_clock(struct htable const *ht)
 {
-	assert(ht);
+#ifdef HTABLE_USE_STATS
+	if (ht->stats) {
+		struct timespec t;
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		return t.tv_sec * 1000000000L + t.tv_nsec;
+	}
+#endif
+	(void)ht;
+	return 0;
+}
 
-	// rehash if necessary
-	if (ht->cap == 0) {
-		int const shift = ht->shift +
-			(ht->len > HTABLE_CAP(ht->shift) / 2);
-		if ((*err = htable_rehash(ht, shift))) {
-			return NULL;
-		}
+/* ht_rehashed adds the time of a rehash (or a migration) since `t0`. */
+static inline
+void ht_rehashed(struct htable const *ht, long t0, int count)
+{
+#ifdef HTABLE_USE_STATS
+	if (ht->stats) {
+		HTABLE_ADD(&ht->stats->rehashes, count);
+		HTABLE_ADD(&ht->stats->rehash_ns, ht_clock(ht) - t0);
 	}
+#endif
+	(void)ht;
+	(void)t0;
+	(void)count;
+}
 
-	unsigned long hash = ht_hashof(ht, key);
-	long i;
-	long j = -1;
-	HTABLE_PROBE_LOOP(i, hash, ht,
-		if (ht->table[i].hash == HBUCKET_EMPTY) {
-			if (j < 0) {
-				ht->cap--;
-			} else {
-				i = j;
-			}
-			ht->table[i].hash = hash;
-			ht->len++;
-			*err = 0;
-			return &ht->data[i * ht->inc];
-		} else if (ht->table[i].hash == HBUCKET_TOMB) {
-			j = j < 0 ? i : j;
-		} else if (ht_isequal(ht, i, hash, key)) {
-			*err = -EEXIST;
-			return &ht->data[i * ht->inc];
-		}
-	);
+#ifdef HTABLE_USE_STATS
+/* ht_statmax raises the counter `max` to `n` */
+static inline
+void ht_statmax(long *max, long n)
+{
+	long m = __atomic_load_n(max, __ATOMIC_RELAXED);
+	while (n > m && !__atomic_compare_exchange_n(max, &m, n, 1,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+#endif
 
-	assert(0);
+/* ht_probed returns the result `idx` of a lookup that probed `n` buckets
+ * (or groups) from its home, counting the probes of hits and misses.
+ */
+static inline
+long ht_probed(struct htable const *ht, long idx, long n)
+{
+#ifdef HTABLE_USE_STATS
+	struct htable_stats *const st = ht->stats;
+	if (st && idx >= 0) {
+		HTABLE_ADD(&st->hits, 1);
+		HTABLE_ADD(&st->hit_probes, n);
+		ht_statmax(&st->hit_probe_max, n);
+	} else if (st) {
+		HTABLE_ADD(&st->misses, 1);
+		HTABLE_ADD(&st->miss_probes, n);
+		ht_statmax(&st->miss_probe_max, n);
+	}
+#else
+	(void)ht;
+	(void)n;
+#endif
+	return idx;
 }
 
-void *htable_enter(struct htable *ht,
-		void const *key, void const *entry, int *err)
+static
+long ht_home(struct htable const *ht, unsigned long hash)
 {
-	assert(ht);
-	assert(ht->hasher->comp(key, entry) == 0);
+	return (hash * HTABLE_MULT) >> (HTABLE_BITS - ht->shift);
+}
 
-	void *e = htable_enter_unsafe(ht, key, err);
-	if (*err == 0) {
-		memmove(e, entry, ht->inc);
+/* ht_prefetch starts loading the home bucket and entry of `hash`. */
+static
+void ht_prefetch(struct htable const *ht, unsigned long hash)
+{
+	if (ht->mask >= 0) {
+		long const i = ht_home(ht, hash);
+#ifdef HTABLE_USE_SIMD
+		HTABLE_PREFETCH(ht->ctrl + (i & ~(long)(HGROUP_SIZE - 1)));
+#endif
+		HTABLE_PREFETCH(ht->table + i * ht->hstride);
+		HTABLE_PREFETCH(ht_entry(ht, i));
 	}
-	return e;
 }
 
-void *htable_find(struct htable const *ht, void const *key)
+static
+int ht_isused(struct htable const *ht, long idx)
 {
-	assert(ht);
+#ifdef HTABLE_USE_SIMD
+	return ht->ctrl[idx] < HCTRL_EMPTY;
+#else
+	return ht_hash(ht, idx) >= HBUCKET_USED;
+#endif
+}
 
-	unsigned long hash = ht_hashof(ht, key);
-	long i;
-	HTABLE_PROBE_LOOP(i, hash, ht,
-		if (ht->table[i].hash == HBUCKET_EMPTY) {
-			return NULL;
-		} else if (ht->table[i].hash == HBUCKET_TOMB) {
+/* Number of buckets tested at once by ht_next. */
+#define HTABLE_SCAN	8
+
+/* ht_next returns the first used bucket in [`idx`, `end`) or `end`.
+ * Runs of free buckets are skipped a group (HTABLE_USE_SIMD) or
+ * HTABLE_SCAN hashes at a time: the bitwise or of hashes is at most
+ * HBUCKET_TOMB only if none of them is used.
+ */
+static
+long ht_next(struct htable const *ht, long idx, long end)
+{
+	while (idx < end) {
+#ifdef HTABLE_USE_SIMD
+		if (idx % HGROUP_SIZE == 0 && end - idx >= HGROUP_SIZE) {
+			hgroup_mask const m = ~hgroup_free(ht->ctrl + idx) &
+				HGROUP_ALL;
+			if (m) {
+				return idx + hgroup_first(m);
+			}
+			idx += HGROUP_SIZE;
 			continue;
-		} else if (ht_isequal(ht, i, hash, key)) {
-			return &ht->data[i * ht->inc];
 		}
-	);
+#else
+		if (end - idx >= HTABLE_SCAN) {
+			unsigned long h = 0;
+			int k;
+			for (k = 0; k < HTABLE_SCAN; k++) {
+				h |= ht_hash(ht, idx + k);
+			}
+			if (h <= HBUCKET_TOMB) {
+				idx += HTABLE_SCAN;
+				continue;
+			}
+		}
+#endif
+		if (ht_isused(ht, idx)) {
+			return idx;
+		}
+		idx++;
+	}
+	return end;
+}
 
-	assert(0);
+/* ht_setslot sets the hash (or the state) of bucket `idx`. */
+static
+void ht_setslot(struct htable *ht, long idx, unsigned long hash)
+{
+	char *const b = ht->table + idx * ht->hstride;
+	if (ht->layout & HTABLE_HASH32) {
+		((struct hbucket32 *)b)->hash = hash;
+	} else {
+		((struct hbucket *)b)->hash = hash;
+	}
+#ifdef HTABLE_USE_SIMD
+	ht->ctrl[idx] = hash >= HBUCKET_USED ? ht_tagof(ht, hash) :
+		hash == HBUCKET_EMPTY ? HCTRL_EMPTY : HCTRL_TOMB;
+#endif
 }
 
-void *htable_delete(struct htable *ht, void const *key)
+/* Probing primitives:
+ * - ht_lookup returns the bucket of `key` or -1 if not found.
+ * - ht_insert returns the bucket of `key`, claiming a free one if needed.
+ * - ht_place claims an empty bucket for an entry known to be absent.
+ * - ht_remove releases a used bucket and returns the removed entry.
+ * - ht_settle returns the best bucket for the entry of bucket `idx`
+ *   (an empty one earlier in its probe sequence) or `idx` itself.
+ */
+#ifdef HTABLE_USE_SIMD
+
+static
+long ht_lookup(struct htable const *ht, unsigned long hash, void const *key)
 {
-	assert(ht);
+	if (ht->mask < 0) {
+		return -1;
+	}
 
-	unsigned long hash = ht_hashof(ht, key);
-	long i;
-	HTABLE_PROBE_LOOP(i, hash, ht,
-		if (ht->table[i].hash == HBUCKET_EMPTY) {
-			return NULL;
-		} else if (ht->table[i].hash == HBUCKET_TOMB) {
-			continue;
-		} else if (ht_isequal(ht, i, hash, key)) {
-			ht->table[i].hash = HBUCKET_TOMB;
-			ht->len--;
-			return &ht->data[i * ht->inc];
+	unsigned char const tag = ht_tagof(ht, hash);
+	long g;
+	HGROUP_LOOP(g, hash, ht,
+		unsigned char const *const ctrl = ht->ctrl + g;
+		hgroup_mask m;
+		for (m = hgroup_match(ctrl, tag); m; m &= m - 1) {
+			long const i = g + hgroup_first(m);
+			if (ht_isequal(ht, i, hash, key)) {
+				return ht_probed(ht, i, ht__i / HGROUP_SIZE + 1);
+			}
+		}
+		if (hgroup_match(ctrl, HCTRL_EMPTY)) {
+			return ht_probed(ht, -1, ht__i / HGROUP_SIZE + 1);
 		}
 	);
 
 	assert(0);
 }
 
-int htable_delete_unsafe(struct htable *ht, void const *entry)
+static
+long ht_insert(struct htable *ht, unsigned long hash, void const *key,
+		int *err)
 {
-	assert(ht);
-
-	if (!entry) {
-		return -EINVAL;
-	}
-
-	long const i = ((char *)entry - ht->data) / ht->inc;
-	if (ht->table[i].hash >= HBUCKET_USED) {
-		ht->table[i].hash = HBUCKET_TOMB;
-		ht->len--;
-		return 0;
-	}
+	unsigned char const tag = ht_tagof(ht, hash);
+	long j = -1;
+	long g;
+	HGROUP_LOOP(g, hash, ht,
+		unsigned char const *const ctrl = ht->ctrl + g;
+		hgroup_mask m;
+		for (m = hgroup_match(ctrl, tag); m; m &= m - 1) {
+			long const i = g + hgroup_first(m);
+			if (ht_isequal(ht, i, hash, key)) {
+				*err = -EEXIST;
+				return i;
+			}
+		}
+		m = hgroup_free(ctrl);
+		if (j < 0 && m) {
+			j = g + hgroup_first(m);
+		}
+		if (hgroup_match(ctrl, HCTRL_EMPTY)) {
+			if (ht->ctrl[j] == HCTRL_EMPTY) {
+				ht->cap--;
+			} else {
+				ht->tomb--;
+			}
+			ht_setslot(ht, j, hash);
+			ht->len++;
+			*err = 0;
+			return j;
+		}
+	);
 
-	return -ENOENT;
+	assert(0);
 }
 
-long htable_len(struct htable const *ht)
+static
+long ht_place(struct htable *ht, unsigned long hash)
+{
+	long g;
+	HGROUP_LOOP(g, hash, ht,
+		hgroup_mask const m = hgroup_match(ht->ctrl + g, HCTRL_EMPTY);
+		if (m) {
+			long const i = g + hgroup_first(m);
+			ht_setslot(ht, i, hash);
+			return i;
+		}
+	);
+
+	assert(0);
+}
+
+static
+void *ht_remove(struct htable *ht, long idx)
+{
+	/* No probe sequence goes past a group with an empty bucket. */
+	long const g = idx & ~(long)(HGROUP_SIZE - 1);
+	if (hgroup_match(ht->ctrl + g, HCTRL_EMPTY)) {
+		ht_setslot(ht, idx, HBUCKET_EMPTY);
+		ht->cap++;
+	} else {
+		ht_setslot(ht, idx, HBUCKET_TOMB);
+		ht->tomb++;
+	}
+	ht->len--;
+	return ht_entry(ht, idx);
+}
+
+static
+long ht_settle(struct htable const *ht, long idx)
+{
+	long g;
+	HGROUP_LOOP(g, ht_hash(ht, idx), ht,
+		hgroup_mask const m = hgroup_match(ht->ctrl + g, HCTRL_EMPTY);
+		if (g == (idx & ~(long)(HGROUP_SIZE - 1))) {
+			return idx;
+		} else if (m) {
+			return g + hgroup_first(m);
+		}
+	);
+
+	assert(0);
+}
+
+#elif defined(HTABLE_USE_ROBINHOOD)
+
+/* Linear probing where an entry takes the bucket of any resident closer
+ * to its home bucket, so that a miss stops at the first resident whose
+ * distance is smaller than the probed one. The distance is computed from
+ * the stored hash and there are no tombs.
+ */
+
+static inline
+long ht_dist(struct htable const *ht, long idx, unsigned long hash)
+{
+	return (idx - ht_home(ht, hash)) & ht->mask;
+}
+
+static
+long ht_lookup(struct htable const *ht, unsigned long hash, void const *key)
+{
+	if (ht->mask < 0) {
+		return -1;
+	}
+
+	long i = ht_home(ht, hash);
+	long d;
+	for (d = 0;; d++, i = (i + 1) & ht->mask) {
+		unsigned long const h = ht_hash(ht, i);
+		if (h == HBUCKET_EMPTY || ht_dist(ht, i, h) < d) {
+			return ht_probed(ht, -1, d + 1);
+		} else if (ht_isequal(ht, i, hash, key)) {
+			return ht_probed(ht, i, d + 1);
+		}
+	}
+}
+
+/* ht_makeroom moves the entries from `idx` to the next empty bucket
+ * one bucket further, which keeps their order and frees `idx`.
+ */
+static
+void ht_makeroom(struct htable *ht, long idx)
+{
+	long i = idx;
+	while (ht_hash(ht, i) != HBUCKET_EMPTY) {
+		i = (i + 1) & ht->mask;
+	}
+	while (i != idx) {
+		long const j = (i - 1) & ht->mask;
+		ht_setslot(ht, i, ht_hash(ht, j));
+		memcpy(ht_entry(ht, i), ht_entry(ht, j), ht->inc);
+		i = j;
+	}
+}
+
+static
+long ht_insert(struct htable *ht, unsigned long hash, void const *key,
+		int *err)
+{
+	long i = ht_home(ht, hash);
+	long d;
+	for (d = 0;; d++, i = (i + 1) & ht->mask) {
+		unsigned long const h = ht_hash(ht, i);
+		if (h == HBUCKET_EMPTY || ht_dist(ht, i, h) < d) {
+			break;
+		} else if (ht_isequal(ht, i, hash, key)) {
+			*err = -EEXIST;
+			return i;
+		}
+	}
+
+	ht_makeroom(ht, i);
+	ht_setslot(ht, i, hash);
+	ht->cap--;
+	ht->len++;
+	*err = 0;
+	return i;
+}
+
+static
+long ht_place(struct htable *ht, unsigned long hash)
+{
+	long i = ht_home(ht, hash);
+	long d;
+	for (d = 0;; d++, i = (i + 1) & ht->mask) {
+		unsigned long const h = ht_hash(ht, i);
+		if (h == HBUCKET_EMPTY || ht_dist(ht, i, h) < d) {
+			break;
+		}
+	}
+
+	ht_makeroom(ht, i);
+	ht_setslot(ht, i, hash);
+	return i;
+}
+
+static
+void *ht_remove(struct htable *ht, long idx)
+{
+	char *const spare = ht_entry(ht, ht->mask + 1);
+	memcpy(spare, ht_entry(ht, idx), ht->inc);
+
+	/* backward shift until an empty bucket or an entry at home */
+	long i = idx;
+	long j = (i + 1) & ht->mask;
+	unsigned long h;
+	while ((h = ht_hash(ht, j)) != HBUCKET_EMPTY && ht_dist(ht, j, h) > 0) {
+		ht_setslot(ht, i, h);
+		memcpy(ht_entry(ht, i), ht_entry(ht, j), ht->inc);
+		i = j;
+		j = (j + 1) & ht->mask;
+	}
+	ht_setslot(ht, i, HBUCKET_EMPTY);
+	ht->cap++;
+	ht->len--;
+	return spare;
+}
+
+static
+long ht_settle(struct htable const *ht, long idx)
+{
+	(void)ht;	/* no tombs to purge */
+	return idx;
+}
+
+#else
+
+static
+long ht_lookup(struct htable const *ht, unsigned long hash, void const *key)
+{
+	if (ht->mask < 0) {
+		return -1;
+	}
+
+	long i;
+	HTABLE_PROBE_LOOP(i, hash, ht,
+		if (ht_hash(ht, i) == HBUCKET_EMPTY) {
+			return ht_probed(ht, -1, ht__i + 1);
+		} else if (ht_hash(ht, i) == HBUCKET_TOMB) {
+			continue;
+		} else if (ht_isequal(ht, i, hash, key)) {
+			return ht_probed(ht, i, ht__i + 1);
+		}
+	);
+
+	assert(0);
+}
+
+static
+long ht_insert(struct htable *ht, unsigned long hash, void const *key,
+		int *err)
+{
+	long i;
+	long j = -1;
+	HTABLE_PROBE_LOOP(i, hash, ht,
+		if (ht_hash(ht, i) == HBUCKET_EMPTY) {
+			if (j < 0) {
+				ht->cap--;
+			} else {
+				ht->tomb--;
+				i = j;
+			}
+			ht_setslot(ht, i, hash);
+			ht->len++;
+			*err = 0;
+			return i;
+		} else if (ht_hash(ht, i) == HBUCKET_TOMB) {
+			j = j < 0 ? i : j;
+		} else if (ht_isequal(ht, i, hash, key)) {
+			*err = -EEXIST;
+			return i;
+		}
+	);
+
+	assert(0);
+}
+
+static
+long ht_place(struct htable *ht, unsigned long hash)
+{
+	long i;
+	HTABLE_PROBE_LOOP(i, hash, ht,
+		if (ht_hash(ht, i) == HBUCKET_EMPTY) {
+			ht_setslot(ht, i, hash);
+			return i;
+		}
+	);
+
+	assert(0);
+}
+
+static
+void *ht_remove(struct htable *ht, long idx)
+{
+	ht_setslot(ht, idx, HBUCKET_TOMB);
+	ht->tomb++;
+	ht->len--;
+	return ht_entry(ht, idx);
+}
+
+static
+long ht_settle(struct htable const *ht, long idx)
+{
+	long i;
+	HTABLE_PROBE_LOOP(i, ht_hash(ht, idx), ht,
+		if (i == idx || ht_hash(ht, i) == HBUCKET_EMPTY) {
+			return i;
+		}
+	);
+
+	assert(0);
+}
+
+#endif /* HTABLE_USE_SIMD, HTABLE_USE_ROBINHOOD */
+
+/* ht_alloc initializes `htnew` as an empty table like `ht` of size 2^shift. */
+static
+int ht_alloc(struct htable *htnew, struct htable const *ht, int shift)
+{
+	long const inc = ht->inc;
+	long const size = HTABLE_SIZE(shift);
+
+	htable_create(htnew, inc, ht->seed, ht->hasher);
+	htnew->step = ht->step;
+	htnew->layout = ht->layout & ~HTABLE_MAPPED;
+	htnew->hstride = ht->hstride;
+	htnew->dstride = ht->dstride;
+	htnew->policy = ht->policy;
+	htnew->alloc = ht->alloc;
+	htnew->stats = ht->stats;
+
+	htnew->table = allocator_alloc(ht->alloc, ht_bytes(ht, size));
+	if (!htnew->table) {
+		return -ENOMEM;
+	}
+	/* no uninitialized padding or free entry, e.g. in snapshots */
+	memset(htnew->table, 0, ht_bytes(ht, size));
+
+	htnew->data = htnew->table + (ht->layout & HTABLE_INLINE ?
+			ht_align(ht->layout, inc) : size * ht->hstride);
+#ifdef HTABLE_USE_SIMD
+	htnew->ctrl = (unsigned char *)htnew->table +
+		ht_bytes(ht, size) - size * HTABLE_CTRL_SIZE;
+#endif
+	htnew->cap = ht_capof(ht, shift);
+	htnew->tomb = 0;
+	htnew->mask = size - 1;
+	htnew->shift = shift;
+
+	long j;
+	for (j = 0; j < size; j++) {
+		ht_setslot(htnew, j, HBUCKET_EMPTY);
+	}
+	return 0;
+}
+
+/* ht_migrate moves at most `n` buckets of the old table to the new one. */
+static
+void ht_migrate(struct htable *ht, long n)
+{
+	struct htable *const old = ht->old;
+	if (!old) {
+		return;
+	}
+
+	long const t0 = ht_clock(ht);
+	long const inc = ht->inc;
+	long j;
+	for (j = ht->pos; j <= old->mask && old->len > 0 && n > 0; n--) {
+		if (ht_isused(old, j)) {
+			long const i = ht_place(ht, ht_hash(old, j));
+			memcpy(ht_entry(ht, i), ht_entry(old, j), inc);
+			ht_remove(old, j);
+		}
+		/* Robin Hood deletion may have shifted the next entry here */
+		if (!ht_isused(old, j)) {
+			j++;
+		}
+	}
+	ht->pos = j;
+
+	if (j > old->mask || old->len == 0) {
+		htable_destroy(old);
+		allocator_free(ht->alloc, old, sizeof(*old));
+		ht->old = NULL;
+		ht->pos = 0;
+	}
+	ht_rehashed(ht, t0, 0);
+}
+
+static
+int htable_rehash(struct htable *ht, int shift, int incremental)
+{
+	assert(ht);
+	assert(shift >= 2 && shift <= HTABLE_BITS - 1);
+
+	ht_migrate(ht, LONG_MAX);
+	assert(ht_capof(ht, shift) >= ht->len);
+
+	long const t0 = ht_clock(ht);
+	struct htable htnew;
+	int err = ht_alloc(&htnew, ht, shift);
+	if (err) {
+		return err;
+	}
+	htnew.len = ht->len;
+	htnew.cap -= ht->len;
+
+	if (incremental && ht->len > 0) {
+		htnew.old = allocator_alloc(ht->alloc, sizeof(*htnew.old));
+		if (!htnew.old) {
+			htable_destroy(&htnew);
+			return -ENOMEM;
+		}
+		*htnew.old = *ht;
+	} else {
+		long const inc = ht->inc;
+		long j;
+		for (j = 0; j <= ht->mask; j++) {
+			if (ht_isused(ht, j)) {
+				long const i = ht_place(&htnew,
+						ht_hash(ht, j));
+				memcpy(ht_entry(&htnew, i),
+						ht_entry(ht, j), inc);
+			}
+		}
+		htable_destroy(ht);
+	}
+
+	*ht = htnew;
+	ht_rehashed(ht, t0, 1);
+	return 0;
+}
+
+int htable_resize(struct htable *ht, long cap)
+{
+	assert(ht);
+	assert(cap > 0);
+	assert(HTABLE_SHIFT_MIN >= 2);
+
+	if (ht->len <= cap) {
+		int shift = ht_capof(ht, ht->shift) <= cap ?
+			ht->shift : HTABLE_SHIFT_MIN;
+		for (; ht_capof(ht, shift) < cap; shift++);
+		return shift != ht->shift ?
+			htable_rehash(ht, shift, 0) : 0;
+	}
+
+	return -ENOSPC;
+}
+
+/* Passes of ht_purge before it falls back to a rehash. */
+#define HTABLE_PURGE_PASSES	4
+
+/* ht_purge turns the tombs into empty buckets in place.
+ * Entries are then moved back up their probe sequence until none of them
+ * is preceded by an empty bucket; each move shortens a probe sequence.
+ * Chains of moves can take many passes: after HTABLE_PURGE_PASSES ones,
+ * the table is rebuilt by a rehash at the same size, and only settled in
+ * place to the end if that rehash cannot allocate.
+ */
+static
+void ht_purge(struct htable *ht)
+{
+	long const inc = ht->inc;
+	long j;
+	for (j = 0; j <= ht->mask; j++) {
+		if (ht_hash(ht, j) == HBUCKET_TOMB) {
+			ht_setslot(ht, j, HBUCKET_EMPTY);
+		}
+	}
+
+	int moved, passes = 0;
+	do {
+		if (passes++ == HTABLE_PURGE_PASSES &&
+				htable_rehash(ht, ht->shift, 0) == 0) {
+			return;
+		}
+		moved = 0;
+		for (j = 0; j <= ht->mask; j++) {
+			if (ht_isused(ht, j)) {
+				long const i = ht_settle(ht, j);
+				if (i != j) {
+					ht_setslot(ht, i, ht_hash(ht, j));
+					memcpy(ht_entry(ht, i),
+							ht_entry(ht, j), inc);
+					ht_setslot(ht, j, HBUCKET_EMPTY);
+					moved = 1;
+				}
+			}
+		}
+	} while (moved);
+
+	ht->cap += ht->tomb;
+	ht->tomb = 0;
+}
+
+void htable_purge(struct htable *ht)
+{
+	assert(ht);
+
+	ht_migrate(ht, LONG_MAX);
+	if (ht->tomb > 0) {
+		ht_purge(ht);
+	}
+}
+
+void htable_setstats(struct htable *ht, struct htable_stats *stats)
+{
+	assert(ht);
+
+	ht->stats = stats;
+	if (ht->old) {
+		ht->old->stats = stats;
+	}
+}
+
+/* Buckets per block of the load histogram of htable_stats. */
+#define HTABLE_STATS_BLOCK	64
+
+/* ht_loadhist adds the loads of the blocks of `t` to `hist`. */
+static
+void ht_loadhist(struct htable const *t, long *hist)
+{
+	long const size = t->mask + 1;
+	long const block = size < HTABLE_STATS_BLOCK ?
+		size : HTABLE_STATS_BLOCK;
+	long j;
+	for (j = 0; j < size; j += block) {
+		long used = 0;
+		long k;
+		for (k = ht_next(t, j, j + block); k < j + block;
+				k = ht_next(t, k + 1, j + block)) {
+			used++;
+		}
+		long const bin = used * HTABLE_STATS_BINS / block;
+		hist[bin < HTABLE_STATS_BINS ? bin : HTABLE_STATS_BINS - 1]++;
+	}
+}
+
+void htable_stats(struct htable const *ht, struct htable_stats *out)
+{
+	assert(ht);
+	assert(out);
+
+	memset(out, 0, sizeof(*out));
+#ifdef HTABLE_USE_STATS
+	struct htable_stats const *const st = ht->stats;
+	if (st) {
+		/* the counters may be updated concurrently */
+#		define HTABLE_LOAD(field)	(out->field =		\
+			__atomic_load_n(&st->field, __ATOMIC_RELAXED))
+		HTABLE_LOAD(finds);
+		HTABLE_LOAD(comps);
+		HTABLE_LOAD(hits);
+		HTABLE_LOAD(hit_probes);
+		HTABLE_LOAD(hit_probe_max);
+		HTABLE_LOAD(misses);
+		HTABLE_LOAD(miss_probes);
+		HTABLE_LOAD(miss_probe_max);
+		HTABLE_LOAD(rehashes);
+		HTABLE_LOAD(rehash_ns);
+#		undef HTABLE_LOAD
+	}
+#else
+	if (ht->stats) {
+		*out = *ht->stats;
+	}
+#endif
+
+	out->len = ht->len;
+	out->size = htable_span(ht);
+	out->tombs = ht->tomb + (ht->old ? ht->old->tomb : 0);
+	memset(out->load_hist, 0, sizeof(out->load_hist));
+	if (ht->old) {
+		ht_loadhist(ht->old, out->load_hist);
+	}
+	if (ht->mask >= 0) {
+		ht_loadhist(ht, out->load_hist);
+	}
+}
+
+void htable_setstep(struct htable *ht, long step)
+{
+	assert(ht);
+	assert(step >= 0);
+
+	ht->step = step;
+}
+
+long htable_migrate(struct htable *ht, long n)
+{
+	assert(ht);
+	assert(n >= 0);
+
+	ht_migrate(ht, n);
+	return ht->old ? ht->old->mask + 1 - ht->pos : 0;
+}
+
+/* ht_reserve makes room for `n` more entries, rehashing if necessary. */
+static
+int ht_reserve(struct htable *ht, long n)
+{
+	if (ht->cap < n) {
+		/* grow unless tombs take up half of the space */
+		int shift = ht->shift +
+			(ht->len > ht_capof(ht, ht->shift) / 2 ?
+			 ht->policy.growth : 0);
+		for (; ht_capof(ht, shift) - ht->len < n; shift++);
+		if (shift == ht->shift && ht->step == 0 &&
+				ht->cap + ht->tomb >= n) {
+			/* mostly tombs: clean up in place */
+			htable_purge(ht);
+			return 0;
+		}
+		return htable_rehash(ht, shift, ht->step > 0);
+	}
+	return 0;
+}
+
+int htable_setpolicy(struct htable *ht, struct htable_policy const *policy)
+{
+	assert(ht);
+	assert(policy);
+
+	if (policy->max_load < 1 || policy->max_load > 255 ||
+			policy->growth < 1 || policy->growth > 8 ||
+			policy->min_load < 0 ||
+			policy->min_load * 2 >= policy->max_load) {
+		return -EINVAL;
+	}
+
+	ht->policy = *policy;
+	if (ht->mask < 0) {
+		return 0;
+	}
+	ht->cap = ht_capof(ht, ht->shift) - ht->len - ht->tomb;
+	return ht_reserve(ht, 0);
+}
+
+/* ht_shrink shrinks the table below `min_load` to twice its length. */
+static
+void ht_shrink(struct htable *ht)
+{
+	if (ht->shift <= HTABLE_SHIFT_MIN || ht->old ||
+			ht->len >= ht_scale(ht->shift, ht->policy.min_load)) {
+		return;
+	}
+
+	int shift = HTABLE_SHIFT_MIN;
+	for (; ht_capof(ht, shift) / 2 < ht->len; shift++);
+	if (shift < ht->shift) {
+		/* on failure keep the current table */
+		htable_rehash(ht, shift, 0);
+	}
+}
+
+/* ht_find returns the entry of `key` in the new or the old table. */
+static
+void *ht_find(struct htable const *ht, unsigned long hash, void const *key)
+{
+	HTABLE_COUNT(ht, finds);
+	long i = ht_lookup(ht, hash, key);
+	if (i >= 0) {
+		return ht_entry(ht, i);
+	}
+
+	struct htable const *const old = ht->old;
+	if (old && (i = ht_lookup(old, hash, key)) >= 0) {
+		return ht_entry(old, i);
+	}
+	return NULL;
+}
+
+/* ht_enter inserts `key` in the new table unless the old one has it. */
+static
+void *ht_enter(struct htable *ht, unsigned long hash, void const *key,
+		int *err)
+{
+	struct htable const *const old = ht->old;
+	long i;
+	if (old && (i = ht_lookup(old, hash, key)) >= 0) {
+		*err = -EEXIST;
+		return ht_entry(old, i);
+	}
+
+	i = ht_insert(ht, hash, key, err);
+	return ht_entry(ht, i);
+}
+
+/* ht_unlink removes the used bucket `idx` of table `t` (new or old). */
+static
+void *ht_unlink(struct htable *ht, struct htable *t, long idx)
+{
+	void *const e = ht_remove(t, idx);
+	if (t != ht) {
+		ht->len--;
+		ht->cap++;
+	}
+	return e;
+}
+
+void *htable_enter_unsafe(struct htable *ht, void const *key, int *err)
+{
+	assert(ht);
+
+	if ((*err = ht_reserve(ht, 1))) {
+		return NULL;
+	}
+	ht_migrate(ht, ht->step);
+
+	return ht_enter(ht, ht_hashof(ht, key), key, err);
+}
+
+void *htable_enter(struct htable *ht,
+		void const *key, void const *entry, int *err)
+{
+	assert(ht);
+
+	return htable_enter_hashed(ht, ht->hasher->hash(key, ht->seed),
+			key, entry, err);
+}
+
+void *htable_enter_hashed(struct htable *ht, unsigned long hash,
+		void const *key, void const *entry, int *err)
+{
+	assert(ht);
+	assert(ht->hasher->comp(key, entry) == 0);
+
+	if ((*err = ht_reserve(ht, 1))) {
+		return NULL;
+	}
+	ht_migrate(ht, ht->step);
+
+	void *const e = ht_enter(ht, ht_hashed(ht, hash), key, err);
+	if (*err == 0) {
+		memmove(e, entry, ht->inc);
+	}
+	return e;
+}
+
+void *htable_find(struct htable const *ht, void const *key)
+{
+	assert(ht);
+
+	return ht_find(ht, ht_hashof(ht, key), key);
+}
+
+void *htable_find_hashed(struct htable const *ht, unsigned long hash,
+		void const *key)
+{
+	assert(ht);
+
+	return ht_find(ht, ht_hashed(ht, hash), key);
+}
+
+long htable_enter_many(struct htable *ht, void const *keys, long nkeys,
+		long key_stride, void const *entries, void **out_entries)
+{
+	assert(ht);
+	assert(nkeys >= 0);
+	assert((keys && entries) || nkeys == 0);
+
+	int err = ht_reserve(ht, nkeys);
+	if (err) {
+		return err;
+	}
+	ht_migrate(ht, ht->step);
+
+	char const *const k = keys;
+	char const *const e = entries;
+	unsigned long hash[HTABLE_BATCH];
+	long n = 0;
+	long i;
+	for (i = 0; i < nkeys; i += HTABLE_BATCH) {
+		long const m = nkeys - i < HTABLE_BATCH ?
+			nkeys - i : HTABLE_BATCH;
+		long j;
+		for (j = 0; j < m; j++) {
+			hash[j] = ht_hashof(ht, k + (i + j) * key_stride);
+			ht_prefetch(ht, hash[j]);
+		}
+		for (j = 0; j < m; j++) {
+			void const *const key = k + (i + j) * key_stride;
+			void const *const entry = e + (i + j) * ht->inc;
+			assert(ht->hasher->comp(key, entry) == 0);
+
+			void *const p = ht_enter(ht, hash[j], key, &err);
+			if (err == 0) {
+				memmove(p, entry, ht->inc);
+				n++;
+			}
+			if (out_entries) {
+				out_entries[i + j] = p;
+			}
+		}
+	}
+#ifdef HTABLE_USE_ROBINHOOD
+	/* later insertions may have shifted the entries found earlier */
+	if (out_entries) {
+		htable_find_many(ht, keys, nkeys, key_stride, out_entries);
+	}
+#endif
+	return n;
+}
+
+struct hbuild {
+	unsigned long hash;
+	long idx;	/* index in the darray	*/
+};
+
+long htable_build(struct htable *ht, struct darray const *entries,
+		void const *(*key_of)(void const *entry))
+{
+	assert(ht);
+	assert(entries);
+	assert(entries->inc == ht->inc);
+
+	long const n = entries->len;
+	if (n == 0) {
+		return 0;
+	}
+
+	/* size once, without leaving a table to migrate */
+	int err = ht_reserve(ht, n);
+	if (err) {
+		return err;
+	}
+	ht_migrate(ht, LONG_MAX);
+
+	struct hbuild *const a = allocator_alloc(ht->alloc, 2 * n * sizeof(*a));
+	if (!a) {
+		return -ENOMEM;
+	}
+	struct hbuild *const b = a + n;
+
+	/* partition by the high bits of the home buckets */
+	int const bits = ht->shift < HTABLE_BUILD_BITS ?
+		ht->shift : HTABLE_BUILD_BITS;
+	int const drop = ht->shift - bits;
+	long count[1L << HTABLE_BUILD_BITS];
+	memset(count, 0, sizeof(long) << bits);
+
+	long const inc = ht->inc;
+	char const *const data = entries->data;
+	long i;
+	for (i = 0; i < n; i++) {
+		void const *const e = data + i * inc;
+		a[i].hash = ht_hashof(ht, key_of ? key_of(e) : e);
+		a[i].idx = i;
+		count[ht_home(ht, a[i].hash) >> drop]++;
+	}
+
+	long sum = 0;
+	for (i = 0; i < 1L << bits; i++) {
+		long const c = count[i];
+		count[i] = sum;
+		sum += c;
+	}
+	for (i = 0; i < n; i++) {
+		b[count[ht_home(ht, a[i].hash) >> drop]++] = a[i];
+	}
+
+	/* insert in bucket order, each partition filling its own region */
+	long m = 0;
+	for (i = 0; i < n; i++) {
+		if (i + HTABLE_BATCH < n) {
+			HTABLE_PREFETCH(data + b[i + HTABLE_BATCH].idx * inc);
+		}
+		void const *const e = data + b[i].idx * inc;
+		void *const p = ht_enter(ht, b[i].hash,
+				key_of ? key_of(e) : e, &err);
+		if (err == 0) {
+			memcpy(p, e, inc);
+			m++;
+		}
+	}
+
+	allocator_free(ht->alloc, a, 2 * n * sizeof(*a));
+	return m;
+}
+
+void htable_find_many(struct htable const *ht, void const *keys, long nkeys,
+		long key_stride, void **out_entries)
+{
+	assert(ht);
+	assert(nkeys >= 0);
+	assert((keys && out_entries) || nkeys == 0);
+
+	char const *const k = keys;
+	unsigned long hash[HTABLE_BATCH];
+	long i;
+	for (i = 0; i < nkeys; i += HTABLE_BATCH) {
+		long const m = nkeys - i < HTABLE_BATCH ?
+			nkeys - i : HTABLE_BATCH;
+		long j;
+		for (j = 0; j < m; j++) {
+			hash[j] = ht_hashof(ht, k + (i + j) * key_stride);
+			ht_prefetch(ht, hash[j]);
+		}
+		for (j = 0; j < m; j++) {
+			out_entries[i + j] = ht_find(ht, hash[j],
+					k + (i + j) * key_stride);
+		}
+	}
+}
+
+void *htable_delete(struct htable *ht, void const *key)
+{
+	assert(ht);
+
+	return htable_delete_hashed(ht, ht->hasher->hash(key, ht->seed), key);
+}
+
+void *htable_delete_hashed(struct htable *ht, unsigned long hash,
+		void const *key)
+{
+	assert(ht);
+
+	/* shrink before, the entry returned stays valid until next call.
+	 * No migration here: it would move buckets under a running yield.
+	 */
+	ht_shrink(ht);
+
+	hash = ht_hashed(ht, hash);
+	struct htable *t = ht;
+	long i = ht_lookup(t, hash, key);
+	if (i < 0 && ht->old) {
+		t = ht->old;
+		i = ht_lookup(t, hash, key);
+	}
+	return i >= 0 ? ht_unlink(ht, t, i) : NULL;
+}
+
+int htable_delete_unsafe(struct htable *ht, void const *entry)
+{
+	assert(ht);
+
+	if (!entry) {
+		return -EINVAL;
+	}
+
+	struct htable *t = ht;
+	if (ht->old && (char const *)entry >= ht->old->data &&
+			(char const *)entry < ht->old->data +
+			(ht->old->mask + 1) * ht->old->dstride) {
+		t = ht->old;
+	}
+
+	long const i = ((char *)entry - t->data) / t->dstride;
+	if (ht_isused(t, i)) {
+		ht_unlink(ht, t, i);
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+long htable_len(struct htable const *ht)
 {
 	assert(ht);
 
 	return ht->len;
 }
 
-void htable_walk(struct htable const *ht,
+long htable_span(struct htable const *ht)
+{
+	assert(ht);
+
+	return (ht->old ? ht->old->mask + 1 : 0) + ht->mask + 1;
+}
+
+void htable_chunk(struct htable const *ht, long i, long n,
+		long *begin, long *end)
+{
+	assert(ht);
+	assert(n > 0 && i >= 0 && i < n);
+	assert(begin && end);
+
+	/* the first `span % n` chunks get one more bucket */
+	long const span = htable_span(ht);
+	long const q = span / n;
+	long const r = span % n;
+	*begin = q * i + (i < r ? i : r);
+	*end = *begin + q + (i < r);
+}
+
+/* ht_walk calls `action` on the used buckets of `t` in [begin, end). */
+static
+void ht_walk(struct htable const *t, long begin, long end,
+		void (*action)(void const *item, void *context),
+		void *context)
+{
+	long j;
+	for (j = ht_next(t, begin, end); j < end; j = ht_next(t, j + 1, end)) {
+		(*action)(ht_entry(t, j), context);
+	}
+}
+
+void htable_walk_range(struct htable const *ht, long begin, long end,
 		void (*action)(void const *item, void *context),
 		void *context)
 {
 	assert(ht);
 	assert(action);
+	assert(begin >= 0);
 
-	long j;
-	for (j = 0; j <= ht->mask; j++) {
-		if (ht->table[j].hash >= HBUCKET_USED) {
-			(*action)(&ht->data[j * ht->inc], context);
-		}
+	/* the buckets of the old table come first */
+	long off = 0;
+	if (ht->old) {
+		off = ht->old->mask + 1;
+		ht_walk(ht->old, begin, end < off ? end : off, action, context);
 	}
+
+	long const size = ht->mask + 1;
+	begin = begin > off ? begin - off : 0;
+	end = end - off < size ? end - off : size;
+	ht_walk(ht, begin, end, action, context);
+}
+
+void htable_walk(struct htable const *ht,
+		void (*action)(void const *item, void *context),
+		void *context)
+{
+	assert(ht);
+	assert(action);
+
+	htable_walk_range(ht, 0, htable_span(ht), action, context);
 }
 
 void *htable_yield(struct htable const *ht, long *iter)
@@ -316,12 +1650,201 @@ void *htable_yield(struct htable const *ht, long *iter)
 	assert(ht);
 	assert(iter && *iter >= 0);
 
-	long j;
-	for (j = *iter; j <= ht->mask; j++) {
-		if (ht->table[j].hash >= HBUCKET_USED) {
-			*iter = j;
-			return &ht->data[j * ht->inc];
+	/* the buckets of the old table come first */
+	long off = 0;
+	if (ht->old) {
+		off = ht->old->mask + 1;
+		if (*iter < off) {
+			void *const e = htable_yield(ht->old, iter);
+			if (e) {
+				return e;
+			}
 		}
 	}
+
+	long const size = ht->mask + 1;
+	long const j = ht_next(ht, *iter > off ? *iter - off : 0, size);
+	if (j < size) {
+		*iter = j + off;
+		return ht_entry(ht, j);
+	}
 	return NULL;
 }
+
+/* Snapshot image: a header then the table as allocated by ht_alloc.
+ * The image depends on the probing strategy, the layout and the size and
+ * byte order of `unsigned long`, which are all checked when mapping it.
+ */
+#define HTABLE_IMAGE_MAGIC	"cdshtab"
+#define HTABLE_IMAGE_VERSION	1
+#define HTABLE_IMAGE_HEADER	128	/* keeps the table aligned */
+
+struct himage {
+	char magic[8];
+	uint32_t version;
+	uint32_t order;		/* 0x01020304 in the saving byte order	*/
+	uint32_t mode;		/* HTABLE_MODE	*/
+	uint32_t bits;		/* HTABLE_BITS	*/
+	int32_t layout;
+	int32_t shift;		/* 0 if no table follows	*/
+	int64_t inc;
+	int64_t len;
+	int64_t tomb;
+	uint64_t seed;
+	int32_t max_load;
+	int32_t growth;
+	int32_t min_load;
+	int32_t reserved;	/* zero, no padding left uninitialized	*/
+};
+
+/* ht_unmap unmaps the header and the table image of a mapped table. */
+static
+void ht_unmap(struct htable *ht)
+{
+	munmap(ht->table - HTABLE_IMAGE_HEADER,
+			HTABLE_IMAGE_HEADER + ht_bytes(ht, ht->mask + 1));
+	ht->layout &= ~HTABLE_MAPPED;
+}
+
+/* ht_write writes `len` bytes to `fd`, retrying partial writes. */
+static
+int ht_write(int fd, void const *buf, size_t len)
+{
+	char const *p = buf;
+	while (len > 0) {
+		ssize_t const n = write(fd, p, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -errno;
+		}
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+int htable_save(struct htable *ht, int fd)
+{
+	assert(ht);
+	assert(fd >= 0);
+
+	ht_migrate(ht, LONG_MAX);
+
+	char header[HTABLE_IMAGE_HEADER] = { 0 };
+	struct himage im = { HTABLE_IMAGE_MAGIC, HTABLE_IMAGE_VERSION,
+		0x01020304, HTABLE_MODE, HTABLE_BITS,
+		ht->layout & ~HTABLE_MAPPED, ht->mask >= 0 ? ht->shift : 0,
+		ht->inc, ht->len, ht->tomb, ht->seed, ht->policy.max_load,
+		ht->policy.growth, ht->policy.min_load, 0 };
+	assert(sizeof(im) <= sizeof(header));
+	memcpy(header, &im, sizeof(im));
+
+	/* unused entries keep deleted data, which the image does not need;
+	 * clean ones are not written to keep mapped pages shared
+	 */
+	long j;
+	for (j = 0; ht->mask >= 0 && j <= ht->mask + HTABLE_SPARE; j++) {
+		if (j > ht->mask || !ht_isused(ht, j)) {
+			char *const e = ht_entry(ht, j);
+			long k;
+			for (k = 0; k < ht->inc && !e[k]; k++);
+			if (k < ht->inc) {
+				memset(e, 0, ht->inc);
+			}
+		}
+	}
+
+	int err = ht_write(fd, header, sizeof(header));
+	if (!err && ht->mask >= 0) {
+		err = ht_write(fd, ht->table, ht_bytes(ht, ht->mask + 1));
+	}
+	return err;
+}
+
+int htable_map(struct htable *ht, char const *path)
+{
+	assert(ht);
+	assert(path);
+
+	if (ht->len > 0) {
+		return -EBUSY;
+	}
+
+	int const fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return -errno;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		int const err = -errno;
+		close(fd);
+		return err;
+	}
+
+	struct himage im;
+	if (st.st_size < HTABLE_IMAGE_HEADER ||
+			pread(fd, &im, sizeof(im), 0) != sizeof(im) ||
+			memcmp(im.magic, HTABLE_IMAGE_MAGIC, 8) != 0 ||
+			im.version != HTABLE_IMAGE_VERSION ||
+			im.order != 0x01020304 ||
+			im.mode != HTABLE_MODE ||
+			im.bits != HTABLE_BITS ||
+			(im.layout & ~(HTABLE_INLINE | HTABLE_HASH32 |
+				       HTABLE_MIX)) ||
+			im.inc != ht->inc) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	struct htable_policy const policy = {
+		im.max_load, im.growth, im.min_load
+	};
+	int err;
+	if ((err = htable_setlayout(ht, im.layout)) ||
+			(err = htable_setpolicy(ht, &policy))) {
+		close(fd);
+		return err;
+	}
+	ht->seed = im.seed;
+	if (im.shift == 0) {
+		close(fd);
+		return im.len == 0 ? 0 : -EINVAL;
+	}
+
+	/* same bound as htable_rehash; 2^(HTABLE_BITS - 1) does not fit */
+	long const size = im.shift >= HTABLE_SHIFT_MIN &&
+		im.shift <= HTABLE_BITS - 1 ? HTABLE_SIZE(im.shift) : 0;
+	if (size <= 0 || im.len < 0 || im.tomb < 0 ||
+			ht_capof(ht, im.shift) - im.len - im.tomb < 0 ||
+			st.st_size != HTABLE_IMAGE_HEADER +
+			ht_bytes(ht, size)) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	/* private: writes copy the pages, the file is never modified */
+	char *const base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE, fd, 0);
+	err = base == MAP_FAILED ? -errno : 0;
+	close(fd);
+	if (err) {
+		return err;
+	}
+
+	ht->table = base + HTABLE_IMAGE_HEADER;
+	ht->data = ht->table + (ht->layout & HTABLE_INLINE ?
+			ht_align(ht->layout, ht->inc) : size * ht->hstride);
+#ifdef HTABLE_USE_SIMD
+	ht->ctrl = (unsigned char *)ht->table +
+		ht_bytes(ht, size) - size * HTABLE_CTRL_SIZE;
+#endif
+	ht->layout |= HTABLE_MAPPED;
+	ht->shift = im.shift;
+	ht->mask = size - 1;
+	ht->len = im.len;
+	ht->tomb = im.tomb;
+	ht->cap = ht_capof(ht, im.shift) - im.len - im.tomb;
+	return 0;
+}
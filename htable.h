@@ -31,11 +31,92 @@
  * \brief Generic hash table.
  */
 
+#include <limits.h>
+#include <stdint.h>
+
+#include "allocator.h"
+
+struct darray;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-struct hbucket;
+/* Flags (htable.c only) to select the probing strategy:
+ * - HTABLE_USE_SIMD probes 16 buckets per step using 1-byte control tags
+ *   and SSE2/NEON compares.
+ * - HTABLE_USE_ROBINHOOD uses Robin Hood linear probing: misses stop
+ *   early and deletions leave no tombs but shift the following entries
+ *   back, so deleting while iterating may skip entries.
+ * The default is triangular probing with tombs.
+ */
+
+#if ULONG_MAX == 0xffffffff
+#	define HTABLE_BITS 32
+#	define HTABLE_MULT 0x93c467e3U
+#elif ULONG_MAX == 0xffffffffffffffff
+#	define HTABLE_BITS 64
+#	define HTABLE_MULT 0x93c467e37db0c7a3U
+#else
+#	error ULONG_WIDTH different from 32 and 64 not implemented.
+#endif
+
+/* Probing strategies, recorded in the tables created by htable.c. */
+enum htable_mode {
+	HTABLE_MODE_DEFAULT   = 0,
+	HTABLE_MODE_SIMD      = 1,
+	HTABLE_MODE_ROBINHOOD = 2,
+};
+
+/*! Number of bins of the load histogram of `struct htable_stats`. */
+#define HTABLE_STATS_BINS	8
+
+/*! Statistics of a hash table, see `htable_setstats` and `htable_stats`.
+ * Probes are counted in buckets, or in groups of 16 buckets with
+ * `HTABLE_USE_SIMD`, each table being probed separately during an
+ * incremental rehash.
+ */
+struct htable_stats {
+	/* counters, with HTABLE_USE_STATS only */
+	long finds;	/*!< calls to `htable_find` and the like	*/
+	long comps;	/*!< calls to `comp` by lookups and insertions	*/
+	long hits;	/*!< lookups of present keys, deletions included	*/
+	long hit_probes;	/*!< total probes of hits	*/
+	long hit_probe_max;	/*!< longest probe of a hit	*/
+	long misses;	/*!< key lookups of absent keys	*/
+	long miss_probes;	/*!< total probes of misses	*/
+	long miss_probe_max;	/*!< longest probe of a miss	*/
+	long rehashes;	/*!< table reallocations	*/
+	long rehash_ns;	/*!< time spent rehashing and migrating	*/
+	/* state, filled by htable_stats */
+	long len;	/*!< number of entries	*/
+	long size;	/*!< number of buckets	*/
+	long tombs;	/*!< deleted buckets	*/
+	/*! number of blocks of 64 buckets with load in [i/8, (i+1)/8)	*/
+	long load_hist[HTABLE_STATS_BINS];
+};
+
+/*! htable_mix is a strong bijective mixer of hashes (splitmix64 and
+ * murmur3 finalizers).
+ */
+static inline
+unsigned long htable_mix(unsigned long h)
+{
+#if HTABLE_BITS == 64
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9U;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebU;
+	h ^= h >> 31;
+#else
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+#endif
+	return h;
+}
 
 /*! Interface for a hash table. */
 struct htable_interface {
@@ -48,20 +129,52 @@ struct htable_interface {
 	//unsigned long (*jump)(void const *key, unsigned long seed);
 };
 
+/*! Sizing policy of a hash table, see `htable_setpolicy`.
+ * Loads are in 1/256 of the number of buckets.
+ */
+struct htable_policy {
+	int max_load;	/*!< grow above this load, in [1, 255]	*/
+	int growth;	/*!< log2 of the growth factor, at least 1	*/
+	int min_load;	/*!< shrink below this load, `0` never shrinks	*/
+};
+
+/*! Default policy: 75% max load, doubling, no shrinking. */
+#define HTABLE_POLICY_DEFAULT	{ 192, 1, 0 }
+
 /*! Generic hash table.
  * Do not modify its fields unless you know what you are doing.
  */
 struct htable {
 	/* private */
 	char *data;
-	struct hbucket *table;
+	char *table;	/* hashes	*/
+	unsigned char *ctrl;	/* HTABLE_USE_SIMD only	*/
 	long inc;
 	long len;
-	long cap;	/* size * 0.75	*/
+	long cap;	/* size * max_load - len - tomb	*/
+	long tomb;	/* deleted buckets	*/
 	long mask;	/* size - 1	*/
 	int shift;	/* log2(size)	*/
 	unsigned long seed;
 	struct htable_interface const *hasher;
+	struct htable *old;	/* table being migrated	*/
+	long step;	/* buckets migrated per call	*/
+	long pos;	/* next bucket of old to migrate	*/
+	int layout;
+	long hstride;	/* bytes between two hashes	*/
+	long dstride;	/* bytes between two entries	*/
+	struct htable_policy policy;
+	struct allocator const *alloc;	/* NULL for malloc	*/
+	int mode;	/* probing strategy of htable.c	*/
+	struct htable_stats *stats;	/* HTABLE_USE_STATS only	*/
+};
+
+/*! Memory layouts of a hash table, see `htable_setlayout`. */
+enum htable_layout {
+	HTABLE_SPLIT  = 0,	/*!< array of hashes then array of entries */
+	HTABLE_INLINE = 1,	/*!< each entry stored right after its hash */
+	HTABLE_HASH32 = 2,	/*!< 32-bit hashes instead of `unsigned long` */
+	HTABLE_MIX    = 4,	/*!< user hashes mixed by `htable_mix` */
 };
 
 /*! htable_create initializes a hash table `ht` of element of size `inc`.
@@ -71,18 +184,87 @@ struct htable {
 void htable_create(struct htable *ht, long inc, unsigned long seed,
 		struct htable_interface const *hasher);
 
+/*! htable_setlayout sets the memory layout of an empty hash table from
+ * the `htable_layout` flags. The default `HTABLE_SPLIT` touches two cache
+ * lines per successful lookup, `HTABLE_INLINE` only one but scans more
+ * memory on long probe sequences; it favors small entries.
+ * `HTABLE_HASH32` halves the size of the hashes on 64-bit platforms.
+ * `HTABLE_MIX` mixes weak user hashes, whose bits vary little or only in
+ * part of the word, before they pick buckets and are folded to 32 bits.
+ * Keys with equal user hashes still reach `comp`.
+ * It returns `0` on success or `-EBUSY` if the hash table is not empty.
+ */
+int htable_setlayout(struct htable *ht, int layout);
+
+/*! htable_setalloc sets the allocator of an empty hash table, whose
+ * memory is released first. `NULL` restores `malloc` and `free`.
+ * With an arena whose `deallocate` does nothing, a short-lived table may
+ * be dropped without calling `htable_destroy`.
+ * It returns `0` on success or `-EBUSY` if the hash table is not empty.
+ */
+int htable_setalloc(struct htable *ht, struct allocator const *alloc);
+
 /*! htable_destroy frees the memory space internal to the hash table.
  * It does not free the memory allocated by the user for the htable nor
  * the entries. On output, the hash table is empty and in a valid state.
  */
 void htable_destroy(struct htable *ht);
 
-/*! htable_resize resizes hash table space for at least `cap` entries.
+/*! htable_setpolicy sets the sizing policy of the hash table.
+ * The table grows by `2^growth` when it exceeds `max_load` and, if
+ * `min_load` is positive, `htable_delete` shrinks it when the load falls
+ * below `min_load` back to twice its length within `max_load`.
+ * `min_load` must be less than half `max_load` to avoid resizing back and
+ * forth. A table already over `max_load` is grown at once.
+ * It returns `0` on success, `-EINVAL` on invalid policy and `-ENOMEM` on
+ * out of memory (the policy is set anyway).
+ */
+int htable_setpolicy(struct htable *ht, struct htable_policy const *policy);
+
+/*! htable_resize resizes hash table space for at least `cap` entries
+ * within the `max_load` of its policy.
  * It returns `0` on success, `-ENOMEM` on out of memory and `-ENOSPC`
  * if `cap` is too small to contain all the entries.
  */
 int htable_resize(struct htable *ht, long cap);
 
+/*! htable_purge turns the deleted buckets back into empty ones in place,
+ * which shortens the probe sequences. It only allocates memory to rebuild
+ * the table when entries take too many passes to settle back.
+ * It is done automatically when deleted buckets fill the table.
+ */
+void htable_purge(struct htable *ht);
+
+/*! htable_setstats makes the hash table update the counters of `stats`,
+ * `NULL` to stop, when `htable.c` is compiled with `HTABLE_USE_STATS`;
+ * otherwise nothing is counted, at no cost.
+ * `comps / finds` shows how many candidates the hashes let through.
+ * Counters are updated atomically, so `stats` may be shared by tables
+ * used concurrently, e.g. the shards of an `htable_sharded`.
+ */
+void htable_setstats(struct htable *ht, struct htable_stats *stats);
+
+/*! htable_stats copies the counters set by `htable_setstats` (or zeros)
+ * to `out` then fills its state from a scan of the buckets.
+ * Average probe lengths are `hit_probes / hits` and `miss_probes / misses`.
+ */
+void htable_stats(struct htable const *ht, struct htable_stats *out);
+
+/*! htable_setstep enables incremental rehashing when `step` is positive.
+ * When the table grows, the old and the new tables are kept side by side
+ * and each call to `htable_enter` migrates `step` buckets instead of
+ * moving all the entries at once. `htable_delete` does not migrate, so
+ * that entries may still be deleted while iterating.
+ * `0` (the default) disables it. `htable_resize` always rehashes at once.
+ */
+void htable_setstep(struct htable *ht, long step);
+
+/*! htable_migrate migrates at most `n` buckets of an incremental rehash,
+ * e.g. to finish it when idle.
+ * It returns the number of buckets left to migrate.
+ */
+long htable_migrate(struct htable *ht, long n);
+
 /*! htable_enter inserts an entry with key in the hash table.
  * On success, it returns a pointer to the inserted entry and set `*err` to 0.
  * It can fail and set `*err` to:
@@ -105,11 +287,55 @@ void *htable_enter_unsafe(struct htable *ht, void const *key, int *err);
  */
 void *htable_find(struct htable const *ht, void const *key);
 
+/*! htable_enter_many inserts `nkeys` entries like `htable_enter`.
+ * Key `i` is at `keys + i * key_stride` and entry `i` follows the
+ * previous one in `entries`. Space is reserved for all of them first,
+ * then keys are hashed and their buckets prefetched in batches.
+ * If `out_entries` is not `NULL`, it receives the pointers returned by
+ * `htable_enter`. Existing entries are not overwritten.
+ * It returns the number of inserted entries or `-ENOMEM` on out of memory
+ * (nothing is inserted).
+ */
+long htable_enter_many(struct htable *ht, void const *keys, long nkeys,
+		long key_stride, void const *entries, void **out_entries);
+
+/*! htable_build inserts all the entries of the darray `entries`, of
+ * element size `inc`, like `htable_enter`. `key_of` returns the key of
+ * an entry, `NULL` meaning the entry is its own key.
+ * The table is sized once, then entries are hashed, partitioned by the
+ * high bits of their home bucket and inserted partition by partition so
+ * that the writes to the table are mostly sequential.
+ * It returns the number of inserted entries or `-ENOMEM` on out of memory
+ * (nothing is inserted).
+ */
+long htable_build(struct htable *ht, struct darray const *entries,
+		void const *(*key_of)(void const *entry));
+
+/*! htable_find_many searches `nkeys` keys like `htable_find`.
+ * Key `i` is at `keys + i * key_stride` and `out_entries[i]` receives
+ * a pointer to its entry or `NULL` if not found.
+ * Keys are hashed and their buckets prefetched in batches before probing.
+ */
+void htable_find_many(struct htable const *ht, void const *keys, long nkeys,
+		long key_stride, void **out_entries);
+
 /*! htable_delete removes an entry from the hash table.
  * It returns a pointer to the entry or `NULL` if not found.
  */
 void *htable_delete(struct htable *ht, void const *key);
 
+/*! htable_enter_hashed, htable_find_hashed and htable_delete_hashed are
+ * `htable_enter`, `htable_find` and `htable_delete` given the user hash of
+ * `key`, `ht->hasher->hash(key, seed)` with the seed of the table, for
+ * callers that already computed it, e.g. to pick a shard.
+ */
+void *htable_enter_hashed(struct htable *ht, unsigned long hash,
+		void const *key, void const *entry, int *err);
+void *htable_find_hashed(struct htable const *ht, unsigned long hash,
+		void const *key);
+void *htable_delete_hashed(struct htable *ht, unsigned long hash,
+		void const *key);
+
 /*! htable_delete_unsafe removes an entry from the hash table.
  * It is undefined behavior if `entry` does not point to the hash table.
  * It returns `0` on success, `-ENOENT` if `entry` points to an empty
@@ -117,6 +343,29 @@ void *htable_delete(struct htable *ht, void const *key);
  */
 int htable_delete_unsafe(struct htable *ht, void const *entry);
 
+/*! htable_save writes a snapshot of the hash table to the file
+ * descriptor `fd`: a versioned header (size, entry size, seed, length...)
+ * followed by the table image, completing any incremental rehash first.
+ * Unused buckets are written as zeros, so equal tables give equal images;
+ * the entry returned by the last `htable_delete` is cleared.
+ * It returns `0` on success or `-errno` if writing fails.
+ */
+int htable_save(struct htable *ht, int fd);
+
+/*! htable_map loads a snapshot written by `htable_save` into the empty
+ * hash table `ht` by mapping the file, without reading any entry.
+ * `ht` must be created with the same entry size and hasher, and
+ * `htable.c` compiled with the same flags on the same platform. Its seed,
+ * layout and policy are replaced by the saved ones.
+ * Pages are shared with the page cache, and across processes, until the
+ * table is modified: modified pages are copied and the file is left
+ * untouched. `htable_destroy` unmaps the file.
+ * It returns `0` on success, `-EBUSY` if `ht` is not empty, `-EINVAL` if
+ * the file is not a compatible snapshot or `-errno` if opening or mapping
+ * the file fails.
+ */
+int htable_map(struct htable *ht, char const *path);
+
 /*! htable_len returns the number of entries. */
 long htable_len(struct htable const *ht);
 
@@ -127,18 +376,142 @@ void htable_walk(struct htable const *ht,
 		void (*action)(void const *item, void *context),
 		void *context);
 
+/*! htable_span returns the number of bucket positions of the hash table,
+ * the bound of the ranges of `htable_walk_range`. During an incremental
+ * rehash, the positions of the old table come first.
+ */
+long htable_span(struct htable const *ht);
+
+/*! htable_chunk sets [`*begin`, `*end`) to the `i`th of `n` contiguous
+ * ranges of nearly equal size that split the bucket positions.
+ */
+void htable_chunk(struct htable const *ht, long i, long n,
+		long *begin, long *end);
+
+/*! htable_walk_range is `htable_walk` restricted to the entries whose bucket
+ * position is in [`begin`, `end`). Disjoint ranges may be walked by
+ * concurrent threads as long as the hash table is not modified.
+ */
+void htable_walk_range(struct htable const *ht, long begin, long end,
+		void (*action)(void const *item, void *context),
+		void *context);
+
 /*! htable_yield returns a pointer to the first entry in the hash table
  * with position greater than or equal to `iter`.
  * Returns `NULL` if no more entry exists at or after `iter` position.
  */
 void *htable_yield(struct htable const *ht, long *iter);
 
-/*! HTABLE_FOREACH iterates over all the entries of the hash table. */
+/*! HTABLE_FOREACH iterates over all the entries of the hash table.
+ * The current entry may be deleted with `htable_delete`, also during an
+ * incremental rehash, unless the policy shrinks the table or with
+ * `HTABLE_USE_ROBINHOOD`.
+ */
 #define HTABLE_FOREACH(entry, htable)					\
 	for (long ht__idx = 0;						\
 			((entry) = htable_yield((htable), &ht__idx));	\
 			 ht__idx++)
 
+/*! HTABLE_DEFINE defines `struct name`, a hash table of `entry_t` found by
+ * `key_t`, and its `static inline` functions `name_create`,
+ * `name_destroy`, `name_enter`, `name_find`, `name_delete`, `name_len`.
+ * `hash_fn(key_t const *key, unsigned long seed)` returns the hash of
+ * `key` and `eq_fn(key_t const *key, entry_t const *entry)` is non-zero
+ * if `entry` has `key`; both may be functions or macros.
+ * The functions call the generic ones but for `name_find` whose hashing,
+ * comparisons and default probing are inlined (during an incremental
+ * rehash or with another probing strategy, it calls `htable_find`).
+ * `t->ht` may be given to all the other functions of `htable.h`.
+ */
+#define HTABLE_DEFINE(name, key_t, entry_t, hash_fn, eq_fn)		\
+struct name {								\
+	struct htable ht;						\
+};									\
+									\
+static inline								\
+unsigned long name##__hash(void const *key, unsigned long seed)		\
+{									\
+	return hash_fn((key_t const *)key, seed);			\
+}									\
+									\
+static inline								\
+int name##__comp(void const *key, void const *entry)			\
+{									\
+	return !eq_fn((key_t const *)key, (entry_t const *)entry);	\
+}									\
+									\
+static inline								\
+void name##_create(struct name *t, unsigned long seed)			\
+{									\
+	static struct htable_interface const hasher = {			\
+		name##__hash, name##__comp				\
+	};								\
+	htable_create(&t->ht, sizeof(entry_t), seed, &hasher);		\
+}									\
+									\
+static inline								\
+void name##_destroy(struct name *t)					\
+{									\
+	htable_destroy(&t->ht);						\
+}									\
+									\
+static inline								\
+entry_t *name##_enter(struct name *t, key_t const *key,			\
+		entry_t const *entry, int *err)				\
+{									\
+	return (entry_t *)htable_enter(&t->ht, key, entry, err);	\
+}									\
+									\
+/* same hash and triangular probing as htable.c */			\
+static inline								\
+entry_t *name##_find(struct name const *t, key_t const *key)		\
+{									\
+	struct htable const *const ht = &t->ht;				\
+	if (ht->mode != HTABLE_MODE_DEFAULT || ht->old || ht->stats) {	\
+		return (entry_t *)htable_find(ht, key);			\
+	} else if (ht->mask < 0) {					\
+		return NULL;						\
+	}								\
+									\
+	int const h32 = ht->layout & HTABLE_HASH32;			\
+	unsigned long h = hash_fn(key, ht->seed);			\
+	if (ht->layout & HTABLE_MIX) {					\
+		h = htable_mix(h);					\
+	}								\
+	if (h32) {							\
+		h = (uint32_t)(h ^ (h >> 16 >> 16));			\
+	}								\
+	h = h >= 2 ? h : 2;						\
+	long i = (h * HTABLE_MULT) >> (HTABLE_BITS - ht->shift);	\
+	long k;								\
+	for (k = 1;; i = (i + k++) & ht->mask) {			\
+		char const *const b = ht->table + i * ht->hstride;	\
+		unsigned long const bh = h32 ?				\
+			*(uint32_t const *)b : *(unsigned long const *)b; \
+		if (bh == h) {						\
+			entry_t *const e = (entry_t *)			\
+				(ht->data + i * ht->dstride);		\
+			if (eq_fn(key, e)) {				\
+				return e;				\
+			}						\
+		} else if (bh == 0) {					\
+			return NULL;					\
+		}							\
+	}								\
+}									\
+									\
+static inline								\
+entry_t *name##_delete(struct name *t, key_t const *key)		\
+{									\
+	return (entry_t *)htable_delete(&t->ht, key);			\
+}									\
+									\
+static inline								\
+long name##_len(struct name const *t)					\
+{									\
+	return t->ht.len;						\
+}
+
 #ifdef __cplusplus
 }
 #endif
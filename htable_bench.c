@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "darray.h"
+#include "htable.h"
+
+/* Rows: htable,<layout>/<inc>,<len>,<op>,<ns per op>,ns */
+
+unsigned long hash(void const *key, unsigned long seed)
+{
+	uint64_t h = *(uint32_t const *)key ^ seed;
+	h *= 0x9e3779b97f4a7c15U;
+	return h ^ (h >> 32);
+}
+int comp(void const *key, void const *entry)
+{
+	return *(uint32_t const *)key != *(uint32_t const *)entry;
+}
+struct htable_interface iface = { hash, comp };
+
+/* same hash for the specialized table */
+#define U32_HASH(key, seed)	hash((key), (seed))
+#define U32_EQ(key, entry)	(*(key) == *(entry))
+HTABLE_DEFINE(u32tab, uint32_t, uint32_t, U32_HASH, U32_EQ)
+
+static char const *const layouts[] = {
+	"split", "inline", "split+hash32", "inline+hash32",
+};
+
+static char variant[64];
+
+/* lookups are repeated on small tables to last as long as on large ones */
+#define REPS(len)	((len) < (1L << 20) ? (1L << 20) / (len) : 1)
+
+enum { ENTER, FIND_HIT, FIND_MISS, CHURN, BUILD, NOPS };
+
+static char const *const ops[NOPS] = {
+	"enter", "find-hit", "find-miss", "churn", "build",
+};
+
+static double best[NOPS];
+
+/* keep records the time per op since `t0` if it is the best of the runs */
+static void keep(int op, double t0, long n)
+{
+	double const dt = (bench_now() - t0) / n;
+	best[op] = dt < best[op] ? dt : best[op];
+}
+
+/* rows prints the best times of ops [first, last) and resets them */
+static void rows(long len, int first, int last)
+{
+	int op;
+	for (op = first; op < last; op++) {
+		bench_row("htable", variant, len, ops[op], best[op], "ns");
+		best[op] = 1e300;
+	}
+}
+
+/* keys[0..len) are entered, keys[len..2*len) are missing */
+static void bench(int layout, long inc, long len, uint32_t const *keys)
+{
+	static char entry[256];
+	struct htable ht;
+	struct darray da;
+	double t;
+	long const reps = REPS(len);
+	long i;
+	int err, r;
+
+	snprintf(variant, sizeof(variant), "%s/%ld", layouts[layout], inc);
+	darray_create(&da, inc);
+	char *const e = darray_push(&da, len);
+	for (i = 0; i < len; i++) {
+		memcpy(e + i * inc, &keys[i], sizeof(keys[i]));
+	}
+
+	for (r = 0; r < BENCH_RUNS; r++) {
+		long hit = 0;
+		htable_create(&ht, inc, 42, &iface);
+		htable_setlayout(&ht, layout);
+
+		t = bench_now();
+		for (i = 0; i < len; i++) {
+			memcpy(entry, &keys[i], sizeof(keys[i]));
+			htable_enter(&ht, &keys[i], entry, &err);
+		}
+		keep(ENTER, t, len);
+
+		t = bench_now();
+		for (i = 0; i < reps * len; i++) {
+			long const j = (i * 7919) % len;
+			hit += htable_find(&ht, &keys[j]) != NULL;
+		}
+		keep(FIND_HIT, t, reps * len);
+
+		t = bench_now();
+		for (i = 0; i < reps * len; i++) {
+			hit += htable_find(&ht, &keys[len + i % len]) != NULL;
+		}
+		keep(FIND_MISS, t, reps * len);
+
+		/* delete an entry and enter a missing one, same length */
+		t = bench_now();
+		for (i = 0; i < len; i++) {
+			htable_delete(&ht, &keys[i]);
+			memcpy(entry, &keys[len + i], sizeof(keys[i]));
+			htable_enter(&ht, &keys[len + i], entry, &err);
+		}
+		keep(CHURN, t, len);
+
+		if (hit != reps * len || htable_len(&ht) != len) {
+			fprintf(stderr, "unexpected hits: %ld\n", hit);
+		}
+		htable_destroy(&ht);
+
+		htable_create(&ht, inc, 42, &iface);
+		htable_setlayout(&ht, layout);
+		t = bench_now();
+		if (htable_build(&ht, &da, NULL) != len) {
+			fprintf(stderr, "unexpected build length\n");
+		}
+		keep(BUILD, t, len);
+		htable_destroy(&ht);
+	}
+	darray_destroy(&da);
+	rows(len, ENTER, NOPS);
+}
+
+static void bench_typed(int layout, long len, uint32_t const *keys)
+{
+	struct u32tab t;
+	double tm;
+	long const reps = REPS(len);
+	long i;
+	int err, r;
+
+	snprintf(variant, sizeof(variant), "%s/typed", layouts[layout]);
+	u32tab_create(&t, 42);
+	htable_setlayout(&t.ht, layout);
+	for (i = 0; i < len; i++) {
+		u32tab_enter(&t, &keys[i], &keys[i], &err);
+	}
+
+	for (r = 0; r < BENCH_RUNS; r++) {
+		long hit = 0;
+		tm = bench_now();
+		for (i = 0; i < reps * len; i++) {
+			long const j = (i * 7919) % len;
+			hit += u32tab_find(&t, &keys[j]) != NULL;
+		}
+		keep(FIND_HIT, tm, reps * len);
+
+		tm = bench_now();
+		for (i = 0; i < reps * len; i++) {
+			hit += u32tab_find(&t, &keys[len + i % len]) != NULL;
+		}
+		keep(FIND_MISS, tm, reps * len);
+
+		if (hit != reps * len) {
+			fprintf(stderr, "unexpected hits: %ld\n", hit);
+		}
+	}
+	u32tab_destroy(&t);
+	rows(len, FIND_HIT, FIND_MISS + 1);
+}
+
+int main(int argc, char **argv)
+{
+	static long const lens[] = { 1L << 10, 1L << 16, 1L << 20 };
+	static long const incs[] = { 8, 32, 128 };
+	long const max = argc > 1 ? atol(argv[1]) : 1L << 20;
+	uint32_t *keys = malloc(2 * max * sizeof(*keys));
+	int l, k, n;
+
+	for (n = 0; n < NOPS; n++) {
+		best[n] = 1e300;
+	}
+
+	/* distinct keys in random order */
+	bench_shuffle(keys, 2 * max, 1);
+
+	for (n = 0; n < (int)(sizeof(lens) / sizeof(lens[0])); n++) {
+		long const len = lens[n] < max ? lens[n] : max;
+		for (k = 0; k < (int)(sizeof(incs) / sizeof(incs[0])); k++) {
+			for (l = 0; l < 4; l++) {
+				bench(l, incs[k], len, keys);
+			}
+		}
+		for (l = 0; l < 4; l++) {
+			bench_typed(l, len, keys);
+		}
+	}
+
+	free(keys);
+	return 0;
+}
@@ -0,0 +1,217 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "htable_sharded.h"
+
+struct hshard {
+	pthread_rwlock_t lock;
+	struct htable ht;
+};
+
+#if ULONG_MAX == 0xffffffff
+#	define HSHARD_BITS 32
+#	define HSHARD_MULT 0x9e3779b9U
+#elif ULONG_MAX == 0xffffffffffffffff
+#	define HSHARD_BITS 64
+#	define HSHARD_MULT 0x9e3779b97f4a7c15U
+#else
+#	error ULONG_WIDTH different from 32 and 64 not implemented.
+#endif
+
+int htable_sharded_create(struct htable_sharded *hs, int nshards,
+		long inc, unsigned long seed,
+		struct htable_interface const *hasher)
+{
+	assert(hs);
+	assert(nshards > 0 && nshards <= 1 << 16);
+	assert(inc > 0);
+	assert(hasher);
+
+	int bits = 0;
+	for (; (1 << bits) < nshards; bits++);
+
+	hs->shards = malloc(sizeof(hs->shards[0]) << bits);
+	if (!hs->shards) {
+		return -ENOMEM;
+	}
+
+	int i;
+	for (i = 0; i < 1 << bits; i++) {
+		if (pthread_rwlock_init(&hs->shards[i].lock, NULL)) {
+			while (i--) {
+				pthread_rwlock_destroy(&hs->shards[i].lock);
+			}
+			free(hs->shards);
+			hs->shards = NULL;
+			return -ENOMEM;
+		}
+		htable_create(&hs->shards[i].ht, inc, seed, hasher);
+	}
+
+	hs->inc = inc;
+	hs->bits = bits;
+	hs->seed = seed;
+	hs->hasher = hasher;
+	return 0;
+}
+
+void htable_sharded_destroy(struct htable_sharded *hs)
+{
+	assert(hs);
+
+	int i;
+	for (i = 0; hs->shards && i < 1 << hs->bits; i++) {
+		htable_destroy(&hs->shards[i].ht);
+		pthread_rwlock_destroy(&hs->shards[i].lock);
+	}
+	free(hs->shards);
+	hs->shards = NULL;
+}
+
+/* hs_shardof picks the shard of `hash` with the high bits of its mix. */
+static
+struct hshard *hs_shardof(struct htable_sharded const *hs, unsigned long hash)
+{
+	if (hs->bits == 0) {
+		return hs->shards;
+	}
+
+	return &hs->shards[(hash * HSHARD_MULT) >> (HSHARD_BITS - hs->bits)];
+}
+
+int htable_sharded_enter(struct htable_sharded *hs,
+		void const *key, void const *entry, void *out)
+{
+	assert(hs);
+
+	unsigned long const hash = hs->hasher->hash(key, hs->seed);
+	struct hshard *const s = hs_shardof(hs, hash);
+	int err;
+
+	pthread_rwlock_wrlock(&s->lock);
+	void *const e = htable_enter_hashed(&s->ht, hash, key, entry, &err);
+	if (err == -EEXIST && out) {
+		memcpy(out, e, hs->inc);
+	}
+	pthread_rwlock_unlock(&s->lock);
+
+	return err;
+}
+
+int htable_sharded_find(struct htable_sharded *hs, void const *key, void *out)
+{
+	assert(hs);
+
+	unsigned long const hash = hs->hasher->hash(key, hs->seed);
+	struct hshard *const s = hs_shardof(hs, hash);
+
+	pthread_rwlock_rdlock(&s->lock);
+	void const *const e = htable_find_hashed(&s->ht, hash, key);
+	if (e && out) {
+		memcpy(out, e, hs->inc);
+	}
+	pthread_rwlock_unlock(&s->lock);
+
+	return e ? 0 : -ENOENT;
+}
+
+int htable_sharded_delete(struct htable_sharded *hs, void const *key,
+		void *out)
+{
+	assert(hs);
+
+	unsigned long const hash = hs->hasher->hash(key, hs->seed);
+	struct hshard *const s = hs_shardof(hs, hash);
+
+	pthread_rwlock_wrlock(&s->lock);
+	void const *const e = htable_delete_hashed(&s->ht, hash, key);
+	if (e && out) {
+		memcpy(out, e, hs->inc);
+	}
+	pthread_rwlock_unlock(&s->lock);
+
+	return e ? 0 : -ENOENT;
+}
+
+long htable_sharded_len(struct htable_sharded *hs)
+{
+	assert(hs);
+
+	long len = 0;
+	int i;
+	for (i = 0; i < 1 << hs->bits; i++) {
+		pthread_rwlock_rdlock(&hs->shards[i].lock);
+		len += htable_len(&hs->shards[i].ht);
+		pthread_rwlock_unlock(&hs->shards[i].lock);
+	}
+	return len;
+}
+
+void htable_sharded_walk(struct htable_sharded *hs,
+		void (*action)(void const *item, void *context),
+		void *context)
+{
+	assert(hs);
+	assert(action);
+
+	int i;
+	for (i = 0; i < 1 << hs->bits; i++) {
+		pthread_rwlock_rdlock(&hs->shards[i].lock);
+		htable_walk(&hs->shards[i].ht, action, context);
+		pthread_rwlock_unlock(&hs->shards[i].lock);
+	}
+}
+
+int htable_sharded_yield(struct htable_sharded *hs,
+		struct htable_sharded_iter *iter, void *out)
+{
+	assert(hs);
+	assert(iter && iter->shard >= 0 && iter->pos >= 0);
+	assert(out);
+
+	for (; iter->shard < 1L << hs->bits; iter->shard++, iter->pos = 0) {
+		struct hshard *const s = &hs->shards[iter->shard];
+
+		pthread_rwlock_rdlock(&s->lock);
+		void const *const e = htable_yield(&s->ht, &iter->pos);
+		if (e) {
+			memcpy(out, e, hs->inc);
+		}
+		pthread_rwlock_unlock(&s->lock);
+
+		if (e) {
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
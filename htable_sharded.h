@@ -0,0 +1,135 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CDS_HTABLE_SHARDED_H
+#define CDS_HTABLE_SHARDED_H
+
+/*!
+ * \file htable_sharded.h
+ * \author Jonathan Debove
+ * \brief Concurrent hash table made of independently locked htables.
+ */
+
+#include "htable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct hshard;
+
+/*! Concurrent hash table.
+ * Entries are picked from `2^bits` shards by the high bits of their hash,
+ * each shard being a `struct htable` protected by a reader/writer lock.
+ * Entries are copied in and out under the lock since pointers to them
+ * would not survive concurrent writers.
+ * Do not modify its fields unless you know what you are doing.
+ */
+struct htable_sharded {
+	/* private */
+	struct hshard *shards;
+	long inc;
+	int bits;	/* log2(number of shards)	*/
+	unsigned long seed;
+	struct htable_interface const *hasher;
+};
+
+/*! htable_sharded_create initializes a concurrent hash table `hs` of
+ * element of size `inc` with at least `nshards` shards (rounded up to a
+ * power of 2). It returns `0` on success or `-ENOMEM` on out of memory.
+ */
+int htable_sharded_create(struct htable_sharded *hs, int nshards,
+		long inc, unsigned long seed,
+		struct htable_interface const *hasher);
+
+/*! htable_sharded_destroy frees the memory space internal to the hash
+ * table. It must not be called while other threads use it.
+ */
+void htable_sharded_destroy(struct htable_sharded *hs);
+
+/*! htable_sharded_enter copies an entry with key in the hash table.
+ * It returns `0` on success, `-EEXIST` if an entry with key already exists
+ * (it is then copied to `out` if not `NULL`) or `-ENOMEM` on out of memory.
+ */
+int htable_sharded_enter(struct htable_sharded *hs,
+		void const *key, void const *entry, void *out);
+
+/*! htable_sharded_find searches an entry with key in the hash table.
+ * It returns `0` and copies the entry to `out` if not `NULL`,
+ * or returns `-ENOENT` if not found.
+ */
+int htable_sharded_find(struct htable_sharded *hs, void const *key, void *out);
+
+/*! htable_sharded_delete removes an entry from the hash table.
+ * It returns `0` and copies the entry to `out` if not `NULL`,
+ * or returns `-ENOENT` if not found.
+ */
+int htable_sharded_delete(struct htable_sharded *hs, void const *key,
+		void *out);
+
+/*! htable_sharded_len returns the number of entries.
+ * The value may be outdated when other threads write.
+ */
+long htable_sharded_len(struct htable_sharded *hs);
+
+/*! htable_sharded_walk iterates over all the entries of the hash table.
+ * For each entry, the function `action` is called with `context` while
+ * its shard is locked for reading: `action` must not modify `hs`.
+ * Each shard is seen in a consistent state but entries entered or deleted
+ * concurrently in other shards may or may not be seen.
+ */
+void htable_sharded_walk(struct htable_sharded *hs,
+		void (*action)(void const *item, void *context),
+		void *context);
+
+/*! htable_sharded_iter is a position in a sharded hash table:
+ * a shard and a position in its `struct htable`.
+ */
+struct htable_sharded_iter {
+	long shard;
+	long pos;
+};
+
+/*! htable_sharded_yield copies to `out` the first entry in the hash table
+ * with position greater than or equal to `iter`, and sets `iter` to it.
+ * It returns `0` on success or `-ENOENT` if no more entry exists at or
+ * after `iter` position.
+ * It is safe while other threads write, but entries moved by a concurrent
+ * rehash of a shard may be missed or seen twice.
+ */
+int htable_sharded_yield(struct htable_sharded *hs,
+		struct htable_sharded_iter *iter, void *out);
+
+/*! HTABLE_SHARDED_FOREACH copies all the entries of the hash table
+ * to `out` in turn. */
+#define HTABLE_SHARDED_FOREACH(out, hs)					\
+	for (struct htable_sharded_iter hs__it = { 0, 0 };		\
+			htable_sharded_yield((hs), &hs__it, (out)) == 0;	\
+			hs__it.pos++)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDS_HTABLE_SHARDED_H */
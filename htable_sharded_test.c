@@ -0,0 +1,78 @@
+#include <pthread.h>
+#include <stdio.h>
+
+#include "htable_sharded.h"
+
+#define NTHREADS 4
+#define NKEYS 1000
+
+unsigned long hash(void const *key, unsigned long seed)
+{
+	(void)seed;	/* unused */
+	return (unsigned long)(*(int const *)key);
+}
+int comp(void const *key, void const *entry)
+{
+	return *(int const *)key != *(int const *)entry;
+}
+struct htable_interface iface = { hash, comp };
+
+struct htable_sharded hs;
+
+void *worker(void *arg)
+{
+	int const t = *(int *)arg;
+	int i, k;
+	for (i = 0; i < NKEYS; i++) {
+		k = i * NTHREADS + t;
+		htable_sharded_enter(&hs, &k, &k, NULL);	/* Insertion */
+	}
+	for (i = 0; i < NKEYS; i += 2) {
+		k = i * NTHREADS + t;
+		htable_sharded_delete(&hs, &k, NULL);		/* Deletion */
+	}
+	return NULL;
+}
+
+void count(void const *item, void *context)
+{
+	(void)item;
+	++*(long *)context;
+}
+
+int main(void)
+{
+	pthread_t threads[NTHREADS];
+	int ids[NTHREADS];
+	int i, k, e;
+	long n = 0;
+
+	htable_sharded_create(&hs, 8, sizeof(int), 0, &iface);	/* Initialization */
+
+	for (i = 0; i < NTHREADS; i++) {
+		ids[i] = i;
+		pthread_create(&threads[i], NULL, worker, &ids[i]);
+	}
+	for (i = 0; i < NTHREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	printf("len: %ld\n", htable_sharded_len(&hs));
+
+	k = 7;
+	if (htable_sharded_find(&hs, &k, &e) == 0) {		/* Search */
+		printf("find: key=%d, val=%d\n", k, e);
+	}
+
+	htable_sharded_walk(&hs, count, &n);			/* Traversal */
+	printf("walk: %ld entries\n", n);
+
+	n = 0;
+	HTABLE_SHARDED_FOREACH(&e, &hs) {
+		n += e % 2;
+	}
+	printf("foreach: %ld odd keys\n", n);
+
+	htable_sharded_destroy(&hs);				/* Reset */
+
+	return 0;
+}
@@ -1,4 +1,6 @@
+#include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "htable.h"
 
@@ -26,6 +28,8 @@ int main(void)
 {
 	int *e;
 	int i, k, ret;
+	int keys[] = { 4, 5, 16 };
+	void *found[3];
 
 	struct htable ht;					/* Hash table */
 	htable_create(&ht, sizeof(*e), 0, &iface);		/* Initialization */
@@ -40,16 +44,96 @@ int main(void)
 	e = htable_find(&ht, &k);				/* Search */
 	print(e, "find");
 
+	htable_find_many(&ht, keys, 3, sizeof(keys[0]), found);	/* Batch */
+	for (i = 0; i < 3; i++) {
+		printf("find_many: key=%d, %s\n", keys[i],
+				found[i] ? "found" : "not found");
+	}
+
+	int bkeys[] = { 16, 121, 121, 144 };		/* 16 exists */
+	int bvals[] = { 4, 11, 11, 12 };		/* 121 twice */
+	void *entered[4];
+	long n = htable_enter_many(&ht, bkeys, 4, sizeof(bkeys[0]), bvals,
+			entered);				/* Batch insert */
+	printf("enter_many: %ld inserted, len=%ld\n", n, htable_len(&ht));
+	for (i = 0; i < 4; i++) {
+		printf("enter_many: key=%d, val=%d, %s\n", bkeys[i],
+				*(int *)entered[i], entered[i] ==
+				htable_find(&ht, &bkeys[i]) ? "ok" : "stale");
+	}
+
 	e = htable_delete(&ht, &k);				/* Deletion */
 	print(e, "delete");
 
+	struct htable_stats stats;
+	htable_stats(&ht, &stats);				/* Statistics */
+	printf("stats: len=%ld, size=%ld, tombs=%ld\n",
+			stats.len, stats.size, stats.tombs);
+
 	htable_walk(&ht, print, "walk");			/* Traversal */
+	for (i = 0; i < 2; i++) {
+		long begin, end;
+		htable_chunk(&ht, i, 2, &begin, &end);		/* Partition */
+		htable_walk_range(&ht, begin, end, print, "walk_range");
+	}
 	/*
 	HTABLE_FOREACH(e, &ht)
 		print(e, "foreach");
 	*/
 
+	int fd = open("htable_test.img", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	ret = fd < 0 ? -1 : htable_save(&ht, fd);		/* Snapshot */
+	if (fd >= 0) {
+		close(fd);
+	}
 	htable_destroy(&ht);					/* Reset */
+	if (ret) {
+		printf("save failed: %d\n", ret);
+		return 1;
+	}
+
+	htable_create(&ht, sizeof(*e), 0, &iface);
+	ret = htable_map(&ht, "htable_test.img");		/* Mapping */
+	if (ret) {
+		printf("map failed: %d\n", ret);
+		return 1;
+	}
+	k = 64;
+	print(htable_find(&ht, &k), "map");
+	htable_destroy(&ht);
+	remove("htable_test.img");
+
+	struct htable_policy policy = { 224, 1, 32 };		/* 87.5% load */
+	htable_create(&ht, sizeof(*e), 0, &iface);
+	htable_setpolicy(&ht, &policy);				/* Sizing */
+	for (i = 0; i < 100; i++) {
+		k = i * i;
+		htable_enter(&ht, &k, &i, &ret);
+	}
+	htable_stats(&ht, &stats);
+	printf("policy: len=%ld, size=%ld\n", stats.len, stats.size);
+	htable_destroy(&ht);
+
+	char seen[1000] = { 0 };
+	int visits = 0, twice = 0;
+	htable_create(&ht, sizeof(*e), 0, &iface);
+	htable_setstep(&ht, 4);					/* Incremental */
+	for (i = 0; i < 1000; i++) {
+		k = i * i;
+		htable_enter(&ht, &k, &i, &ret);
+	}
+	printf("rehashing: %s\n", htable_migrate(&ht, 0) ? "yes" : "no");
+	HTABLE_FOREACH(e, &ht) {				/* Delete in loop */
+		visits++;
+		twice += seen[*e]++;
+		if (*e % 2 == 0) {
+			k = *e * *e;
+			htable_delete(&ht, &k);
+		}
+	}
+	printf("foreach delete: visits=%d, twice=%d, len=%ld\n",
+			visits, twice, htable_len(&ht));
+	htable_destroy(&ht);
 
 	return 0;
 }
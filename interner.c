@@ -0,0 +1,191 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "fnv1a.h"
+#include "interner.h"
+
+extern struct dstring_view interner_get(struct interner const *in, long id);
+extern long interner_len(struct interner const *in);
+
+/* Arena block, with its size for the allocator. */
+struct in_chunk {
+	char *p;
+	long size;
+};
+
+/* Lookup key, the pool resolves the ids of the entries. */
+struct in_key {
+	struct dstring_view v;
+	struct interner const *in;
+};
+
+static
+unsigned long in_hash(void const *key, unsigned long seed)
+{
+	struct in_key const *k = (struct in_key const *)key;
+	return fnv1a_final(fnv1a_update(fnv1a_init() ^ seed, k->v.p, k->v.len));
+}
+
+static
+int in_comp(void const *key, void const *entry)
+{
+	struct in_key const *k = (struct in_key const *)key;
+	uint32_t id;
+	memcpy(&id, entry, sizeof(id));
+	struct dstring_view const v = interner_get(k->in, id);
+	return v.len != k->v.len || memcmp(v.p, k->v.p, v.len) != 0;
+}
+
+static struct htable_interface const in_iface = { in_hash, in_comp };
+
+void interner_create(struct interner *in, unsigned long seed)
+{
+	assert(in);
+
+	htable_create(&in->ht, sizeof(uint32_t), seed, &in_iface);
+	darray_create(&in->views, sizeof(struct dstring_view));
+	darray_create(&in->chunks, sizeof(struct in_chunk));
+	in->top = NULL;
+	in->left = 0;
+	in->alloc = NULL;
+}
+
+int interner_setalloc(struct interner *in, struct allocator const *alloc)
+{
+	assert(in);
+
+	if (in->views.len > 0) {
+		return -EBUSY;
+	}
+	interner_destroy(in);
+	htable_setalloc(&in->ht, alloc);
+	darray_setalloc(&in->views, alloc);
+	darray_setalloc(&in->chunks, alloc);
+	in->alloc = alloc;
+	return 0;
+}
+
+void interner_destroy(struct interner *in)
+{
+	assert(in);
+
+	long i;
+	for (i = 0; i < in->chunks.len; i++) {
+		struct in_chunk const *const c = darray_at(&in->chunks, i);
+		allocator_free(in->alloc, c->p, c->size);
+	}
+	darray_destroy(&in->chunks);
+	darray_destroy(&in->views);
+	htable_destroy(&in->ht);
+	in->top = NULL;
+	in->left = 0;
+}
+
+/* Bump allocation, large strings get their own block. */
+static
+char *in_alloc(struct interner *in, long size)
+{
+	if (size > in->left) {
+		long const n = size > INTERNER_CHUNK / 4 ? size : INTERNER_CHUNK;
+		struct in_chunk *const c = darray_push(&in->chunks, 1);
+		if (!c) {
+			return NULL;
+		}
+		char *const p = allocator_alloc(in->alloc, n);
+		if (!p) {
+			darray_pop(&in->chunks, 1);
+			return NULL;
+		}
+		c->p = p;
+		c->size = n;
+		if (n == size) {
+			return p;
+		}
+		in->top = p;
+		in->left = n;
+	}
+
+	char *const p = in->top;
+	in->top += size;
+	in->left -= size;
+	return p;
+}
+
+long interner_intern(struct interner *in, char const *str, long len)
+{
+	assert(in);
+	assert(str || len == 0);
+	assert(len >= 0 && len < LONG_MAX);
+
+	/* unsigned: (long)UINT32_MAX is -1 with a 32-bit long */
+	if ((unsigned long)in->views.len >= UINT32_MAX) {
+		long const id = interner_find(in, str, len);
+		return id >= 0 ? id : -ENOSPC;
+	}
+
+	/* the candidate points to str until it is known to be new,
+	 * so that the string is hashed once
+	 */
+	struct dstring_view *const v = (struct dstring_view *)
+		darray_push(&in->views, 1);
+	if (!v) {
+		return -ENOMEM;
+	}
+	v->p = str;
+	v->len = len;
+
+	struct in_key const key = { { str, len }, in };
+	uint32_t const id = in->views.len - 1;
+	int err;
+	uint32_t const *const e = (uint32_t const *)htable_enter(&in->ht,
+			&key, &id, &err);
+	if (err) {
+		darray_pop(&in->views, 1);
+		return err == -EEXIST ? (long)*e : err;
+	}
+
+	char *const p = in_alloc(in, len + 1);
+	if (!p) {
+		htable_delete(&in->ht, &key);
+		darray_pop(&in->views, 1);
+		return -ENOMEM;
+	}
+	memcpy(p, str, len);
+	p[len] = '\0';
+	((struct dstring_view *)in->views.data)[id].p = p;
+	return id;
+}
+
+long interner_find(struct interner const *in, char const *str, long len)
+{
+	assert(in);
+	assert(str || len == 0);
+
+	struct in_key const key = { { str, len }, in };
+	uint32_t const *const e = (uint32_t const *)htable_find(&in->ht, &key);
+	return e ? (long)*e : -ENOENT;
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CDS_INTERNER_H
+#define CDS_INTERNER_H
+
+/*!
+ * \file interner.h
+ * \author Jonathan Debove
+ * \brief String interning pool.
+ */
+
+#include <stdint.h>
+
+#include "darray.h"
+#include "dstring.h"
+#include "htable.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*! Size of the arena blocks holding the strings. */
+#define INTERNER_CHUNK	(1L << 16)
+
+/*! String interning pool.
+ * Each unique string is copied once, null terminated, in arena blocks that
+ * never move, and gets the next id: 0, 1, 2... Equal strings get the same
+ * id and the same pointer, so they compare as integers or pointers.
+ * The hash table holds 4-byte ids keyed by the FNV1a hash of the strings.
+ */
+struct interner {
+	/* private */
+	struct htable ht;	/* uint32_t ids		*/
+	struct darray views;	/* dstring_view by id	*/
+	struct darray chunks;	/* blocks and sizes	*/
+	char *top;		/* free space of the	*/
+	long left;		/* current block	*/
+	struct allocator const *alloc;	/* NULL for malloc	*/
+};
+
+/*! interner_create initializes an empty pool.
+ * It is recommended to supply a random `seed`.
+ */
+void interner_create(struct interner *in, unsigned long seed);
+
+/*! interner_setalloc sets the allocator of an empty pool, used for its
+ * blocks, ids and hash table, whose memory is released first. `NULL`
+ * restores `malloc`, `realloc` and `free`.
+ * It returns `0` on success or `-EBUSY` if the pool is not empty.
+ */
+int interner_setalloc(struct interner *in, struct allocator const *alloc);
+
+/*! interner_destroy frees the pool, its ids and pointers become invalid. */
+void interner_destroy(struct interner *in);
+
+/*! interner_intern returns the id of the `len` characters at `str`,
+ * copying them to the pool if they are new.
+ * It returns `-ENOMEM` on out of memory or `-ENOSPC` if there are already
+ * `UINT32_MAX` strings.
+ */
+long interner_intern(struct interner *in, char const *str, long len);
+
+/*! interner_find returns the id of the `len` characters at `str`,
+ * or `-ENOENT` if they are not in the pool.
+ */
+long interner_find(struct interner const *in, char const *str, long len);
+
+/*! interner_get returns the view of the string of id `id`.
+ * Its pointer is stable until interner_destroy and null terminated.
+ */
+inline
+struct dstring_view interner_get(struct interner const *in, long id)
+{
+	assert(in);
+	assert(id >= 0 && id < in->views.len);
+
+	return ((struct dstring_view const *)in->views.data)[id];
+}
+
+/*! interner_len returns the number of unique strings. */
+inline
+long interner_len(struct interner const *in)
+{
+	assert(in);
+
+	return in->views.len;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CDS_INTERNER_H */
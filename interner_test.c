@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interner.h"
+
+/* malloc counting the bytes in use */
+static long in_use;
+
+static void *count_alloc(void *context, size_t size)
+{
+	(void)context;
+	in_use += size;
+	return malloc(size);
+}
+
+static void *count_realloc(void *context, void *ptr, size_t old, size_t size)
+{
+	(void)context;
+	in_use += (long)size - (long)old;
+	return realloc(ptr, size);
+}
+
+static void count_free(void *context, void *ptr, size_t size)
+{
+	(void)context;
+	in_use -= size;
+	free(ptr);
+}
+
+int main(void)
+{
+	static char const *const hosts[] = {
+		"db1.example.org", "web1.example.org", "db1.example.org",
+		"web2.example.org", "web1.example.org", "db1.example.org",
+	};
+	struct interner in;
+	long ids[6];
+	int i;
+
+	interner_create(&in, 0x5eed);				/* Initialization */
+	for (i = 0; i < 6; i++) {
+		ids[i] = interner_intern(&in, hosts[i], strlen(hosts[i]));
+		printf("%s -> %ld\n", hosts[i], ids[i]);
+	}
+	printf("unique: %ld\n", interner_len(&in));
+	printf("same pointer: %d\n",				/* Stable copies */
+			interner_get(&in, ids[0]).p == interner_get(&in, ids[2]).p);
+	printf("find web2: %ld, find db2: %ld\n",
+			interner_find(&in, "web2.example.org", 16),
+			interner_find(&in, "db2.example.org", 15));
+	interner_destroy(&in);					/* Reset */
+
+	struct allocator al = { count_alloc, count_realloc, count_free, NULL };
+	interner_setalloc(&in, &al);				/* Allocator */
+	for (i = 0; i < 6; i++) {
+		interner_intern(&in, hosts[i], strlen(hosts[i]));
+	}
+	printf("allocator: %ld bytes in use\n", in_use);
+	interner_destroy(&in);
+	printf("allocator: %ld bytes after destroy\n", in_use);
+
+	return 0;
+}
@@ -0,0 +1,263 @@
+/* Copyright (c) 2023, Jonathan Debove
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CDS_WYHASH_H
+#define CDS_WYHASH_H
+
+/*!
+ * \file wyhash.h
+ * \author Jonathan Debove
+ * \brief Seeded word-at-a-time hash functions.
+ *
+ * This is wyhash (final version 4, public domain, by Wang Yi): keys are read
+ * 8 or 16 bytes at a time and mixed with 64x64->128 bit multiplications,
+ * three independent lanes being used for keys longer than 48 bytes.
+ * It is many times faster than FNV1a for keys longer than a few words.
+ *
+ * Results depend on byte order: do not use them across platforms.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stupid macro to help doxygen */
+#define STATIC static
+
+#if defined(__GNUC__)
+#	define WYHASH_LIKELY(x)		__builtin_expect(!!(x), 1)
+#else
+#	define WYHASH_LIKELY(x)		(x)
+#endif
+
+#define WYHASH_P0	UINT64_C(0x2d358dccaa6c78a5)
+#define WYHASH_P1	UINT64_C(0x8bb84b93962eacc9)
+#define WYHASH_P2	UINT64_C(0x4b33a62ed433d4a3)
+#define WYHASH_P3	UINT64_C(0x4d5a2da51de1aa47)
+
+/* Sets *a and *b to the low and high halves of *a * *b. */
+STATIC inline
+void wyhash__mum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__)
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t const ha = *a >> 32, hb = *b >> 32;
+	uint64_t const la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t const rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t const t = rl + (rm0 << 32);
+	uint64_t const lo = t + (rm1 << 32);
+	uint64_t const hi = rh + (rm0 >> 32) + (rm1 >> 32)
+		+ (t < rl) + (lo < t);
+	*a = lo;
+	*b = hi;
+#endif
+}
+
+STATIC inline
+uint64_t wyhash__mix(uint64_t a, uint64_t b)
+{
+	wyhash__mum(&a, &b);
+	return a ^ b;
+}
+
+STATIC inline
+uint64_t wyhash__r8(unsigned char const *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+STATIC inline
+uint64_t wyhash__r4(unsigned char const *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/* Mixes the seed, to be done once per key. */
+STATIC inline
+uint64_t wyhash__seed(unsigned long seed)
+{
+	uint64_t const h = seed;
+	return h ^ wyhash__mix(h ^ WYHASH_P0, WYHASH_P1);
+}
+
+/* Mixes a 48-byte stripe into the three lanes `h`. */
+STATIC inline
+void wyhash__stripe(uint64_t h[3], unsigned char const *p)
+{
+	h[0] = wyhash__mix(wyhash__r8(p) ^ WYHASH_P1, wyhash__r8(p + 8) ^ h[0]);
+	h[1] = wyhash__mix(wyhash__r8(p + 16) ^ WYHASH_P2,
+			wyhash__r8(p + 24) ^ h[1]);
+	h[2] = wyhash__mix(wyhash__r8(p + 32) ^ WYHASH_P3,
+			wyhash__r8(p + 40) ^ h[2]);
+}
+
+/* Hashes a key of `len` bytes, the last `i < 48` of which are at `p`.
+ * For `len > 16`, the 16 bytes before `p + i` must be readable, even when
+ * `i < 16`: they end the stripes already mixed in `h`.
+ */
+STATIC inline
+unsigned long wyhash__tail(uint64_t h, unsigned char const *p, size_t i,
+		size_t len)
+{
+	uint64_t a, b;
+	if (WYHASH_LIKELY(len <= 16)) {
+		if (WYHASH_LIKELY(len >= 4)) {
+			size_t const k = (len >> 3) << 2;
+			a = (wyhash__r4(p) << 32) | wyhash__r4(p + k);
+			b = (wyhash__r4(p + len - 4) << 32)
+				| wyhash__r4(p + len - 4 - k);
+		} else if (WYHASH_LIKELY(len > 0)) {
+			a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8)
+				| p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		while (i > 16) {
+			h = wyhash__mix(wyhash__r8(p) ^ WYHASH_P1,
+					wyhash__r8(p + 8) ^ h);
+			p += 16;
+			i -= 16;
+		}
+		a = wyhash__r8(p + i - 16);
+		b = wyhash__r8(p + i - 8);
+	}
+	a ^= WYHASH_P1;
+	b ^= h;
+	wyhash__mum(&a, &b);
+	return (unsigned long)wyhash__mix(a ^ WYHASH_P0 ^ len, b ^ WYHASH_P1);
+}
+
+/*! wyhash_mem computes the wyhash hash code of a memory area. */
+STATIC inline
+unsigned long wyhash_mem(void const *s, size_t len, unsigned long seed)
+{
+	unsigned char const *p = (unsigned char const *)s;
+	uint64_t h = wyhash__seed(seed);
+	size_t i = len;
+	if (len >= 48) {
+		uint64_t lanes[3] = { h, h, h };
+		do {
+			wyhash__stripe(lanes, p);
+			p += 48;
+			i -= 48;
+		} while (WYHASH_LIKELY(i >= 48));
+		h = lanes[0] ^ lanes[1] ^ lanes[2];
+	}
+	return wyhash__tail(h, p, i, len);
+}
+
+/*!
+ * wyhash_str computes the wyhash hash code of a string.
+ * Its signature allows to use it directly as `htable_interface::hash` when
+ * the keys are the strings themselves.
+ */
+STATIC inline
+unsigned long wyhash_str(void const *s, unsigned long seed)
+{
+	return wyhash_mem(s, strlen((char const *)s), seed);
+}
+
+/*! State of an incremental wyhash. */
+struct wyhash {
+	/* private */
+	uint64_t h[3];			/* lanes			*/
+	size_t len;			/* bytes hashed so far		*/
+	unsigned char buf[16 + 48];	/* last stripe end + pending	*/
+};
+
+/*!
+ * wyhash_init initializes the state of an incremental wyhash.
+ * Fragments are hashed with wyhash_update and the hash code is returned by
+ * wyhash_final, it is the wyhash_mem of their concatenation with the same
+ * `seed`. No memory is allocated.
+ */
+STATIC inline
+void wyhash_init(struct wyhash *w, unsigned long seed)
+{
+	w->h[0] = w->h[1] = w->h[2] = wyhash__seed(seed);
+	w->len = 0;
+}
+
+/*! wyhash_update hashes `len` bytes from `s` into the state `w`. */
+STATIC inline
+void wyhash_update(struct wyhash *w, void const *s, size_t len)
+{
+	unsigned char const *p = (unsigned char const *)s;
+	unsigned char const *end;
+	size_t const n = w->len % 48;
+	w->len += len;
+	if (n + len < 48) {
+		memcpy(w->buf + 16 + n, p, len);
+		return;
+	}
+
+	/* a stripe is mixed as soon as it is complete, like wyhash_mem does */
+	if (n > 0) {
+		memcpy(w->buf + 16 + n, p, 48 - n);
+		wyhash__stripe(w->h, w->buf + 16);
+		p += 48 - n;
+		len -= 48 - n;
+		end = w->buf + 64;
+	} else {
+		end = NULL;
+	}
+	while (len >= 48) {
+		wyhash__stripe(w->h, p);
+		p += 48;
+		len -= 48;
+		end = p;
+	}
+	memmove(w->buf, end - 16, 16);
+	memcpy(w->buf + 16, p, len);
+}
+
+/*! wyhash_final returns the hash code of the state `w`. */
+STATIC inline
+unsigned long wyhash_final(struct wyhash const *w)
+{
+	uint64_t h = w->h[0];
+	if (w->len >= 48) {
+		h ^= w->h[1] ^ w->h[2];
+	}
+	return wyhash__tail(h, w->buf + 16, w->len % 48, w->len);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* CDS_WYHASH_H */